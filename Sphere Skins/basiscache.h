@@ -0,0 +1,84 @@
+#ifndef BASISCACHE_H
+#define BASISCACHE_H
+
+#include <complex>
+#include <typeinfo>
+
+#include <QPair>
+#include <QSharedPointer>
+#include <QVector>
+
+#include "functions.h"
+#include "coordinategrid.h"
+
+// bytes of basis planes the tiles of one preview may hold between them; a
+// job whose share would be larger is rendered directly
+const qint64 BASIS_CACHE_BUDGET = qint64(256) << 20;
+
+// single-term delta updates allowed between full re-sums of the cached field
+const int BASIS_RESUM_INTERVAL = 64;
+
+// What the field of a render job depends on besides the coefficients: the
+// function family, the term frequencies, the coordinate grid and the job's
+// block of pixels
+struct JobKey
+{
+    const std::type_info *family;
+    QVector<QPair<int, int> > frequencies;
+    QSharedPointer<CoordinateGrid> grid;
+    int firstColumn, firstRow, columns, rows;
+
+    JobKey() : family(0), firstColumn(0), firstRow(0), columns(0), rows(0) { }
+    JobKey(const AbstractFunction *function, const FunctionPlan &plan, const QSharedPointer<CoordinateGrid> &grid,
+           int firstColumn, int firstRow, int columns, int rows);
+    bool operator==(const JobKey &other) const;
+};
+
+// Keeps the basis functions b_k of every term (see FunctionPlan) over one
+// render job, so that f = sum_k coeff_k * b_k can be re-summed without
+// evaluating anything while the user only edits coefficients or the scale.
+// If just one coefficient moved since the last sum, the field is updated in
+// place with field += (new - old) * b_k, one pass over two planes.
+//
+// Planes are built the second time in a row the same job (see JobKey) is
+// rendered, so a one-off render never pays for them.
+class BasisCache
+{
+public:
+    enum Lookup { BASIS_MISS, BASIS_BUILD, BASIS_HIT };
+
+    BasisCache() : columns(0), rows(0), built(false), summed(false), deltas(0) { }
+
+    // BASIS_HIT if the planes already hold this job, BASIS_BUILD if they
+    // have just been allocated and should be filled through planeRe/planeIm
+    // and finishBuilding(), BASIS_MISS if the job is to be rendered directly
+    Lookup lookup(const JobKey &job);
+    void finishBuilding();
+    bool isBuilt() const { return built; }
+    
+    // whether lookup() would be a BASIS_HIT, without touching the cache
+    bool holds(const JobKey &job) const { return built && job == key; }
+
+    // term k's values down one column of the job, to be filled while building
+    double *planeRe(int k, int column) { return basisRe.data() + (k * columns + column) * rows; }
+    double *planeIm(int k, int column) { return basisIm.data() + (k * columns + column) * rows; }
+
+    // brings the field up to date with the plan's coefficients
+    void combine(const FunctionPlan &plan);
+    const double *fieldRe(int column) const { return sumRe.constData() + column * rows; }
+    const double *fieldIm(int column) const { return sumIm.constData() + column * rows; }
+
+private:
+    void accumulate(int k, std::complex<double> weight);
+
+    JobKey key;
+    int columns, rows;
+    bool built, summed;
+    int deltas;
+    QVector<double> basisRe, basisIm;           // [(k * columns + column) * rows + row]
+    QVector<bool> finite;                       // whether plane k is free of poles
+    QVector<std::complex<double> > weights;     // coefficients the field was summed with
+    QVector<double> sumRe, sumIm;               // [column * rows + row]
+};
+
+#endif // BASISCACHE_H
@@ -4,31 +4,32 @@ ControllerThread::ControllerThread(AbstractFunction *function, ColorWheel *color
 {
     QMutexLocker locker(&mutex);
     
-    numThreadsActive = 0;
-    
     NUM_THREADS = idealThreadCount() != -1 ? idealThreadCount() : 8;
     
     //NUM_THREADS = 1;         //for testing
     
-    restart = false;
-    abort = false;
+    restart.storeRelease(0);
+    abort.storeRelease(0);
+    progressive = true;
+    finestStep = 1;
     
     currFunction = function;
     currColorWheel = colorwheel;
     currSettings = settings;
     
     this->controllerObject = controllerObject;
-    this->controllerObject->setNumThreadsActive(NUM_THREADS);
     
-    qRegisterMetaType<Q2DArray>("Q2DArray");
+    scheduler.setWorkers(NUM_THREADS);
+    scheduler.setTileSize(QSize(RENDER_TILE_WIDTH, RENDER_TILE_HEIGHT));
+    
     qRegisterMetaType<ComplexValue>("ComplexValue");
     
     for (int i = 0; i < NUM_THREADS; i++) {
         RenderThread *nextThread = new RenderThread(currFunction, currColorWheel, currSettings, outputSize);
         threads.push_back(nextThread);
-        connect(nextThread, SIGNAL(renderingFinished(QPoint, Q2DArray)), controllerObject, SLOT(handleRenderedImageParts(QPoint, Q2DArray)));
-        connect(nextThread, SIGNAL(newProgress(double)), controllerObject, SLOT(handleNewProgress(double)));
+        connect(nextThread, SIGNAL(tileFinished(int, QRect)), controllerObject, SLOT(handleFinishedTile(int, QRect)));
         connect(nextThread, SIGNAL(newImageDataPoint(ComplexValue)), controllerObject, SLOT(addNewImageDataPoint(ComplexValue)));
+        connect(nextThread, SIGNAL(termsSkipped(int)), controllerObject, SLOT(handleTermsSkipped(int)));
     }
     
     connect(this, SIGNAL(finished()), this, SLOT(deleteLater()));
@@ -37,8 +38,8 @@ ControllerThread::ControllerThread(AbstractFunction *function, ColorWheel *color
 ControllerThread::~ControllerThread()
 {
     mutex.lock();
-    restart = false;
-    abort = true;
+    restart.storeRelease(0);
+    abort.storeRelease(1);
     
     restartCondition.wakeOne();
     mutex.unlock();
@@ -46,7 +47,7 @@ ControllerThread::~ControllerThread()
     wait();
 }
 
-void ControllerThread::prepareToRun(QImage *output, const int &actionFlag)
+void ControllerThread::prepareToRun(const QSharedPointer<RenderTarget> &output, const int &actionFlag)
 {
     
     QMutexLocker locker(&mutex);
@@ -60,54 +61,57 @@ void ControllerThread::prepareToRun(QImage *output, const int &actionFlag)
         threads[i]->changeFunction(imageFunction);
         threads[i]->changeColorWheel(imageColorWheel);
         threads[i]->changeSettings(imageSettings);
+        threads[i]->setActionFlag(actionFlag);
     }
     
-    this->output = output;
+    target = output;
     overallWidth = output->width();
     overallHeight = output->height();
     this->actionFlag = actionFlag;
+    finestStep = 1;
     controllerObject->setActionFlag(this->actionFlag);
-    controllerObject->setOutput(this->output);
-    
-    numThreadsActive = threads.size();
-    
-    controllerObject->setNumThreadsRunning(numThreadsActive);
     
     if (!isRunning()) {
         start(InheritPriority);
     }
     else {
+        scheduler.cancel();
         controllerObject->setRestart(true);
-        restart = true;
+        restart.storeRelease(1);
         emit newWork();
         restartCondition.wakeOne();
     }
     
 }
 
-void ControllerThread::prepareToRun(Display *display, const int &actionFlag)
+void ControllerThread::prepareToRun(Display *display, const int &actionFlag, int finestStep)
 {
     
     QMutexLocker locker(&mutex);
     
     
-    this->display = display;
-    overallWidth = display->getWidth();
-    overallHeight = display->getHeight();
+    target = display->getTarget();
+    overallWidth = target->width();
+    overallHeight = target->height();
     this->actionFlag = actionFlag;
-    controllerObject->setActionFlag(this->actionFlag);
-    controllerObject->setDisplay(this->display);
+    this->finestStep = qBound(1, finestStep, PREVIEW_COARSEST_STEP);
     
-    numThreadsActive = threads.size();
+    // the threads' coordinate grid has to cover the frame laid out over
+    // the target, or the tiles would read past its columns and rows
+    for (int i = 0; i < threads.size(); i++) {
+        threads[i]->setActionFlag(actionFlag);
+        threads[i]->changeDimensions(overallWidth, overallHeight);
+    }
     
-    controllerObject->setNumThreadsRunning(numThreadsActive);
+    controllerObject->setActionFlag(this->actionFlag);
     
     if (!isRunning()) {
         start(InheritPriority);
     }
     else {
+        scheduler.cancel();
         controllerObject->setRestart(true);
-        restart = true;
+        restart.storeRelease(1);
         emit newWork();
         restartCondition.wakeOne();
     }
@@ -116,41 +120,59 @@ void ControllerThread::prepareToRun(Display *display, const int &actionFlag)
 void ControllerThread::run()
 {
     forever {
-        if (abort) return;
+        if (abort.loadAcquire()) return;
         
+        // a preview is drawn in passes, one pixel in PREVIEW_COARSEST_STEP
+        // first and halving the step down to every pixel (or to finestStep
+        // while the user is interacting with it), so that it shows up well
+        // before the full render is done; new work drops the passes that
+        // are left
         mutex.lock();
+        bool passes = actionFlag == DISPLAY_REPAINT_FLAG && (progressive || finestStep > 1);
+        int step = passes ? PREVIEW_COARSEST_STEP : 1;
+        int lastStep = passes ? finestStep : 1;
         
-        int width = overallWidth;
-        int height = overallHeight;
-        int counter = overallWidth/numThreadsActive;
+        // the plan and what evaluating it takes are made here, once for
+        // all passes and tiles
+        QSharedPointer<FrameEvaluation> evaluation = threads[0]->prepareFrame(overallWidth, overallHeight);
+        mutex.unlock();
         
-        for (int i = 0; i < numThreadsActive; i++)
+        for (; step >= lastStep && !restart.loadAcquire(); step /= 2)
         {
-            if (restart) break;
-            if (abort) return;
-            if (i == numThreadsActive - 1) {
-                threads[i]->render(QPoint(i * counter, 0), QPoint(width, height), &allWorkersFinishedCondition);
+            mutex.lock();
+            
+            // every thread works through the tiles of the new frame, stealing
+            // from the others once its own share is done
+            int frame = scheduler.start(overallWidth, overallHeight);
+            controllerObject->startFrame(frame, scheduler.tileCount(), step == lastStep);
+            
+            for (int i = 0; i < threads.size(); i++)
+            {
+                if (restart.loadAcquire()) break;
+                if (abort.loadAcquire()) return;
+                threads[i]->render(&scheduler, frame, i, target, evaluation, step, step == lastStep,
+                                   &allWorkersFinishedCondition);
             }
-            else {
-                threads[i]->render(QPoint(i * counter, 0), QPoint((i + 1) * counter, height), &allWorkersFinishedCondition);
-            }
-        }
+            
+            mutex.unlock();
         
-        mutex.unlock();
-        
-        if (!restart) {
-            QEventLoop q;
-            connect(this, SIGNAL(newWork()), &q, SLOT(quit()));
-            connect(controllerObject, SIGNAL(allThreadsFinished()), &q, SLOT(quit()));
-            q.exec();
+            if (!restart.loadAcquire()) {
+                QEventLoop q;
+                connect(this, SIGNAL(newWork()), &q, SLOT(quit()));
+                connect(controllerObject, SIGNAL(allThreadsFinished()), &q, SLOT(quit()));
+                
+                // new work may have come in before the connections were made
+                if (!restart.loadAcquire())
+                    q.exec();
+            }
         }
         
         mutex.lock();
-        if (!restart) {
+        if (!restart.loadAcquire()) {
             restartCondition.wait(&mutex);
         }
         
-        restart = false;
+        restart.storeRelease(0);
         controllerObject->setRestart(false);
         mutex.unlock();
     }
@@ -0,0 +1,66 @@
+#include "coordinategrid.h"
+
+#include <QMutex>
+#include <QMutexLocker>
+
+CoordinateGrid::CoordinateGrid(const Settings &settings, int columns, int rows)
+    : width(settings.Width), height(settings.Height), xCorner(settings.XCorner), yCorner(settings.YCorner),
+      columnCount(columns), rowCount(rows), longitude(columns), radius(rows)
+{
+    double worldXStart = width / columns;
+    for (int x = 0; x < columns; x++)
+        longitude[x] = x * worldXStart + xCorner;
+
+    double worldYStart1 = height + yCorner;
+    double worldYStart2 = height / rows;
+    for (int y = 0; y < rows; y++)
+    {
+        //worldY should be an angle with 0 <= Y < pi
+        double worldY = worldYStart1 - y * worldYStart2;
+        if (1 - qCos(worldY) == 0)
+            worldY += worldYStart2 / 2;
+        radius[y] = qSin(worldY)/(1-qCos(worldY));
+    }
+}
+
+bool CoordinateGrid::matches(const Settings &settings, int columns, int rows) const
+{
+    return width == settings.Width && height == settings.Height && xCorner == settings.XCorner
+        && yCorner == settings.YCorner && columnCount == columns && rowCount == rows;
+}
+
+QSharedPointer<CoordinateGrid> CoordinateGrid::shared(const Settings &settings, int columns, int rows)
+{
+    static QMutex cacheMutex;
+    static QList<QSharedPointer<CoordinateGrid> > cache;   // most recently used first
+
+    QMutexLocker locker(&cacheMutex);
+
+    for (int k = 0; k < cache.size(); k++)
+    {
+        if (cache[k]->matches(settings, columns, rows)) {
+            QSharedPointer<CoordinateGrid> grid = cache[k];
+            cache.move(k, 0);
+            return grid;
+        }
+    }
+
+    QSharedPointer<CoordinateGrid> grid(new CoordinateGrid(settings, columns, rows));
+    cache.prepend(grid);
+    while (cache.size() > COORDINATE_GRID_CACHE_SIZE)
+        cache.removeLast();
+
+    return grid;
+}
+
+void CoordinateGrid::points(int x, int firstRow, int rowStep, int count, double *re, double *im) const
+{
+    //compute stereographic projection of the column's angles
+    std::complex<double> turn = ei(longitude[x]);
+    for (int i = 0; i < count; i++)
+    {
+        std::complex<double> zStereo = turn * radius[firstRow + i * rowStep];
+        re[i] = zStereo.real();
+        im[i] = zStereo.imag();
+    }
+}
@@ -0,0 +1,47 @@
+#ifndef COORDINATEGRID_H
+#define COORDINATEGRID_H
+
+#include <QSharedPointer>
+#include <QVector>
+
+#include "shared.h"
+
+// how many grids CoordinateGrid::shared() keeps alive between renders
+// (typically the preview, the history icons and the last export)
+const int COORDINATE_GRID_CACHE_SIZE = 3;
+
+// The stereographic point z = ei(worldX) * sin(worldY) / (1 - cos(worldY))
+// of every pixel of an overallWidth x overallHeight render, keyed by the
+// world rectangle (Settings Width/Height/XCorner/YCorner) and output size.
+// Only the per-column longitudes and per-row radii are kept, as z is
+// their product; points() makes the z of a column's rows from them, into
+// the caller's buffers. Once built, the grid is shared read-only by every
+// RenderThread, so re-rendering after a coefficient change regenerates no
+// coordinates at all, and keeping a grid cached costs only its two axes
+// even at export size.
+//
+// A row on a pole, where 1 - cos(worldY) = 0, is moved half a row into the
+// image so that its radius stays finite.
+class CoordinateGrid
+{
+public:
+    static QSharedPointer<CoordinateGrid> shared(const Settings &settings, int columns, int rows);
+
+    int columns() const { return columnCount; }
+    int rows() const { return rowCount; }
+    const double *longitudes() const { return longitude.constData(); }     // worldX of each column
+    const double *radii() const { return radius.constData(); }             // |z| of each row (signed past a pole)
+
+    // z at rows firstRow, firstRow + rowStep, ... of column x, count of them
+    void points(int x, int firstRow, int rowStep, int count, double *re, double *im) const;
+
+private:
+    CoordinateGrid(const Settings &settings, int columns, int rows);
+    bool matches(const Settings &settings, int columns, int rows) const;
+
+    double width, height, xCorner, yCorner;
+    int columnCount, rowCount;
+    QVector<double> longitude, radius;
+};
+
+#endif // COORDINATEGRID_H
@@ -10,6 +10,10 @@
 #include <QDebug>
 #include <QVector>
 #include <QMouseEvent>
+#include <QPaintEvent>
+#include <QSharedPointer>
+
+#include "rendertarget.h"
 
 const double SCREEN_SCALING_FACTOR = 0.25;
 const double MAX_PREVIEW_IMAGE_SIZE = 600;
@@ -21,9 +25,12 @@ class Display : public QWidget
 
 public:
     explicit Display(double imageWidth = 200, double imageHeight = 200, QWidget *parent = 0);
-    void setPixel(int i, int j, QRgb color);
-    QSize sizeHint() const { return disp.size(); }
-    QImage *getImage() { return &disp; }
+    QSize sizeHint() const { return QSize(target->width(), target->height()); }
+    const QImage &getImage() const { return target->image(); }
+    
+    // the frame the render threads write into; shared with them so that it
+    // outlives a render that is still finishing
+    QSharedPointer<RenderTarget> getTarget() const { return target; }
 //    void shrink();
 //    void enlarge();
     int getWidth() { return width;}
@@ -45,8 +52,7 @@ protected:
 
 private:
     
-    QImage disp;
-    QVector<QVector<QRgb>> colorMap;
+    QSharedPointer<RenderTarget> target;
     double width, height;
 
     QPoint topLeft;
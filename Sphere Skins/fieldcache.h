@@ -0,0 +1,58 @@
+#ifndef FIELDCACHE_H
+#define FIELDCACHE_H
+
+#include <complex>
+
+#include <QVector>
+
+#include "basiscache.h"
+
+// precision the retained field is stored in; float halves its memory and
+// read traffic at about 1e-7 relative error in the colors' input
+typedef double FieldSample;
+
+// The complex field f(z) of one render job, kept after the job is colored.
+// A re-render whose job and coefficients have not changed (a new color
+// wheel, image, overflow color or tilt) only re-runs the color wheel over
+// it instead of evaluating the function again.
+//
+// While a preview is drawn coarse to fine, the field also collects the
+// samples of the coarse passes (see RenderThread::sketchTile), so that the
+// full-resolution pass only evaluates the pixels they left out.
+class FieldCache
+{
+public:
+    FieldCache() : rows(0), complete(false), sketchStep(0) { }
+
+    // true if the field holds this job with exactly the plan's coefficients
+    bool holds(const JobKey &job, const FunctionPlan &plan) const;
+
+    // forgets the old field and makes room for the job's; the columns are
+    // then written with store() and the field holds the job after finish()
+    void reset(const JobKey &job, const FunctionPlan &plan);
+    void store(int column, const double *re, const double *im);
+    void finish() { complete = true; }
+
+    // rows firstRow, firstRow + rowStep, ... of a column, from a coarse
+    // pass; sketched() records that every sample of the pass at that step
+    // is in, and holdsSketch() whether the field holds the job's samples
+    // down to the given step (that is, at every step-th column and row)
+    void storeSamples(int column, int firstRow, int rowStep, int count, const double *re, const double *im);
+    void sketched(int step) { sketchStep = step; }
+    bool holdsSketch(const JobKey &job, const FunctionPlan &plan, int step) const;
+
+    const FieldSample *fieldRe(int column) const { return valuesRe.constData() + column * rows; }
+    const FieldSample *fieldIm(int column) const { return valuesIm.constData() + column * rows; }
+
+private:
+    bool sameTerms(const JobKey &job, const FunctionPlan &plan) const;
+
+    JobKey key;
+    QVector<std::complex<double> > coefficients;
+    int rows;
+    bool complete;
+    int sketchStep;         // 0 if the coarse passes' samples are not all in
+    QVector<FieldSample> valuesRe, valuesIm;    // [column * rows + row]
+};
+
+#endif // FIELDCACHE_H
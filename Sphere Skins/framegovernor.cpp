@@ -0,0 +1,46 @@
+#include "framegovernor.h"
+
+#include "renderthread.h"
+
+// the samples of a frame drawn coarse to fine down to step: the passes
+// before the full-resolution one together take pixels / step^2, and the
+// full one evaluates every pixel again
+double FrameGovernor::samples(int step, int pixels, int terms)
+{
+    double perTerm = step > 1 ? double(pixels) / (step * step) : 1.25 * pixels;
+    return perTerm * qMax(terms, 1);
+}
+
+int FrameGovernor::interactiveStep(const Combination &combination, int pixels, int terms) const
+{
+    if (!costs.contains(combination))
+        return PREVIEW_COARSEST_STEP;
+
+    double cost = costs.value(combination);
+    for (int step = 1; step < PREVIEW_COARSEST_STEP; step *= 2)
+    {
+        if (cost * samples(step, pixels, terms) <= budget)
+            return step;
+    }
+
+    return PREVIEW_COARSEST_STEP;
+}
+
+void FrameGovernor::recordFrame(const Combination &combination, int step, int pixels, int terms, qint64 elapsed,
+                                bool finished)
+{
+    double cost = elapsed / samples(step, pixels, terms);
+
+    if (!costs.contains(combination)) {
+        if (finished)
+            costs.insert(combination, cost);
+        return;
+    }
+
+    // an unfinished frame only bounds the cost from below
+    double &estimate = costs[combination];
+    if (finished)
+        estimate += FRAME_COST_SMOOTHING * (cost - estimate);
+    else
+        estimate = qMax(estimate, cost);
+}
@@ -1,4 +1,9 @@
 #include "functions.h"
+#include "powerladder.h"
+#include "polyhedral.h"
+#include "legendre.h"
+
+#include <QMap>
 
 AbstractFunction::AbstractFunction(QVector<coeffpair> &in_coeffs, QVector<freqpair> &in_freqs)
 {
@@ -128,6 +133,234 @@ void AbstractFunction::refresh()
     scale.setA(0.0);
 }
 
+// appends one term to a plan, widening powerMin..powerMax to cover it
+static void addPlanTerm(FunctionPlan &plan, std::complex<double> coeff, int n, int m)
+{
+    PlanTerm term;
+    term.coeff = coeff;
+    term.n = n;
+    term.m = m;
+    plan.terms.push_back(term);
+    
+    plan.powerMin = qMin(plan.powerMin, qMin(n, m));
+    plan.powerMax = qMax(plan.powerMax, qMax(n, m));
+}
+
+FunctionPlan AbstractFunction::compileTerms() const
+{
+    FunctionPlan plan;
+    std::complex<double> scaling = scale.combined();
+    
+    plan.terms.reserve(terms);
+    for(unsigned int k = 0; k < terms; k++)
+        addPlanTerm(plan, coeffs[k].combined() * scaling, freqs[k].N(), freqs[k].M());
+    
+    return plan;
+}
+
+FunctionPlan AbstractFunction::compile() const
+{
+    return compile(compileTerms());
+}
+
+// expands a term list from compileTerms(), leaving out the terms whose
+// coefficient is zero
+FunctionPlan AbstractFunction::compile(const FunctionPlan &terms) const
+{
+    FunctionPlan plan;
+    for(int k = 0; k < terms.terms.size(); k++)
+    {
+        const PlanTerm &term = terms.terms[k];
+        if(term.coeff != 0.0)
+            addPlanTerm(plan, term.coeff, term.n, term.m);
+    }
+    
+    expand(plan);
+    
+    return plan;
+}
+
+FunctionPlan AbstractFunction::compileTerm(unsigned int k) const
+{
+    FunctionPlan plan;
+    addPlanTerm(plan, 1.0, freqs[k].N(), freqs[k].M());
+    expand(plan);
+    
+    return plan;
+}
+
+// response of a pixel-wide box filter to a wave whose phase advances by
+// the given amount per pixel, or 0 from the Nyquist limit on
+static double pixelResponse(double phase)
+{
+    phase = qAbs(phase);
+    if(phase >= M_PI) return 0.0;
+    if(phase == 0.0) return 1.0;
+    return qSin(phase / 2) / (phase / 2);
+}
+
+// Draft renders leave out what their pixels cannot show. A term whose phase
+// advances by phi per pixel along an image axis is scaled by sinc(phi/2),
+// as if averaged over each pixel, and dropped from phi >= pi on, where it
+// would only alias into noise. Attenuated terms that end up under
+// DETAIL_THRESHOLD of the largest coefficient are dropped too. Dropped terms
+// keep their place with a zero coefficient; the count of them is returned.
+// Terms of unknown frequency are left alone.
+int AbstractFunction::limitDetail(FunctionPlan &terms, double xPitch, double yPitch) const
+{
+    double largest = 0.0;
+    for(int k = 0; k < terms.terms.size(); k++)
+        largest = qMax(largest, std::abs(terms.terms[k].coeff));
+    
+    int dropped = 0;
+    for(int k = 0; k < terms.terms.size(); k++)
+    {
+        PlanTerm &term = terms.terms[k];
+        if(term.coeff == 0.0) continue;
+        
+        double alongX, alongY;
+        termFrequencies(term, &alongX, &alongY);
+        double response = pixelResponse(alongX * xPitch) * pixelResponse(alongY * yPitch);
+        if(response < 1.0 && std::abs(term.coeff) * response < DETAIL_THRESHOLD * largest)
+            response = 0.0;
+        
+        term.coeff *= response;
+        if(response == 0.0) dropped++;
+    }
+    
+    return dropped;
+}
+
+// sums a harmonic plan at one point: one table of every P_l^m(zee) serves
+// all the harmonics, and e^(i m theta) comes off a power ladder
+std::complex<double> AbstractFunction::evaluateHarmonics(const FunctionPlan &plan, double x, double y) const
+{
+    double r2 = x * x + y * y;
+    LegendreTable legendre((1.0 - r2) / (1.0 + r2), plan.harmonicDegree);
+    
+    std::complex<double> phase = r2 > 0.0 ? std::complex<double>(x, y) / qSqrt(r2) : 1.0;
+    PowerLadder turn(phase, -plan.harmonicDegree, plan.harmonicDegree);
+    
+    std::complex<double> ans(0,0);
+    for(int k = 0; k < plan.harmonics.size(); k++)
+    {
+        const PlanTerm &harmonic = plan.harmonics[k];
+        ans += harmonic.coeff * legendre(harmonic.n, qAbs(harmonic.m)) * turn[harmonic.m];
+    }
+    
+    return ans;
+}
+
+// sqrt of the mean of (P_l^m(zee) cos(m theta))^2 over the sphere, up to the
+// same constant for every l and m
+static double harmonicNorm(int l, int m)
+{
+    double ratio = 1.0;     // (l+m)! / (l-m)!
+    for(int k = l - m + 1; k <= l + m; k++)
+        ratio *= k;
+    return qSqrt(2.0 / (2 * l + 1) * ratio);
+}
+
+// Rewrites each term, the harmonic P_2M^2N(zee) cos(2N theta) averaged over
+// the orbit, as harmonics P_l^|m|(zee) e^(i m theta) at the point itself.
+// The orbit maps are rotations of the sphere, so a term stays within its
+// degree l = 2M and quadrature recovers it exactly: Gauss-Legendre with l+1
+// nodes in zee by 2l+1 equally spaced longitudes. Terms outside
+// 0 <= N <= M have no harmonic and vanish; harmonics that average out (up
+// to quadrature rounding) are dropped.
+void AbstractFunction::expandHarmonics(FunctionPlan &plan, const QVector<Mobius> &orbit)
+{
+    const double TWO_PI = 6.28318530717958647692;
+    QMap<QPair<int, int>, std::complex<double> > merged;
+    double magnitude = 0.0;
+    
+    for(int k = 0; k < plan.terms.size(); k++)
+    {
+        const PlanTerm &term = plan.terms[k];
+        if(term.n < 0 || term.m < term.n) continue;
+        
+        int l = 2 * term.m, order = 2 * term.n;
+        int nodes = l + 1, longitudes = 2 * l + 1;
+        magnitude += std::abs(term.coeff) * harmonicNorm(l, order);
+        
+        QVector<double> zee(nodes), weight(nodes);
+        gaussLegendre(nodes, zee.data(), weight.data());
+        
+        QVector<std::complex<double> > phases(longitudes * longitudes);    // [b * longitudes + m + l] = e^(-i m theta_b)
+        for(int b = 0; b < longitudes; b++)
+            for(int m = -l; m <= l; m++)
+                phases[b * longitudes + m + l] = std::polar(1.0, -m * TWO_PI * b / longitudes);
+        
+        QVector<std::complex<double> > projection(longitudes);
+        for(int a = 0; a < nodes; a++)
+        {
+            LegendreTable legendre(zee[a], l);
+            double r = qSqrt((1.0 - zee[a]) / (1.0 + zee[a]));
+            
+            for(int b = 0; b < longitudes; b++)
+            {
+                std::complex<double> z = std::polar(r, TWO_PI * b / longitudes);
+                double average = 0.0;
+                for(int g = 0; g < orbit.size(); g++)
+                {
+                    std::complex<double> p, q;
+                    orbit[g].apply(z, p, q);
+                    double pp = std::norm(p), qq = std::norm(q);
+                    double theta = std::arg(p * conj(q));
+                    average += associatedLegendre(l, order, (qq - pp) / (qq + pp)) * qCos(order * theta);
+                }
+                average /= orbit.size();
+                
+                for(int m = -l; m <= l; m++)
+                    projection[m + l] += weight[a] * average * legendre(l, qAbs(m)) * phases[b * longitudes + m + l];
+            }
+        }
+        
+        for(int m = -l; m <= l; m++)
+        {
+            double norm = harmonicNorm(l, qAbs(m));
+            merged[qMakePair(l, m)] += term.coeff * projection[m + l] / (longitudes * norm * norm);
+        }
+    }
+    
+    plan.polar = true;
+    plan.harmonic = true;
+    plan.harmonics.clear();
+    plan.harmonicDegree = 0;
+    for(QMap<QPair<int, int>, std::complex<double> >::const_iterator it = merged.constBegin(); it != merged.constEnd(); ++it)
+    {
+        int l = it.key().first, m = it.key().second;
+        if(std::abs(it.value()) * harmonicNorm(l, qAbs(m)) <= 1e-12 * magnitude)
+            continue;
+        
+        PlanTerm harmonic;
+        harmonic.coeff = it.value();
+        harmonic.n = l;
+        harmonic.m = m;
+        plan.harmonics.push_back(harmonic);
+        plan.harmonicDegree = qMax(plan.harmonicDegree, l);
+    }
+}
+
+// a term's harmonics all have degree l = 2M, and P_l^m(cos phi) e^(i m theta)
+// oscillates at most l times per radian along either image axis
+void AbstractFunction::harmonicFrequencies(const PlanTerm &term, double *alongX, double *alongY)
+{
+    *alongX = *alongY = (term.n < 0 || term.m < term.n) ? 0.0 : 2.0 * term.m;
+}
+
+// evaluates a run of points into structure-of-arrays real/imaginary buffers;
+// the spherical families have no plane-wave form, so this is one evaluate()
+// per point
+void AbstractFunction::evaluateBatch(const FunctionPlan &plan, const double *x, const double *y, int count, double *re, double *im) const
+{
+    for (int k = 0; k < count; k++) {
+        std::complex<double> ans = evaluate(plan, x[k], y[k]);
+        re[k] = ans.real();
+        im[k] = ans.imag();
+    }
+}
+
 void AbstractFunction::initWithVectors(QVector<coeffpair> &in_coeffs, QVector<freqpair> &in_freqs)
 {
     terms = in_coeffs.size() < in_freqs.size() ? in_coeffs.size() : in_freqs.size();
@@ -146,9 +379,11 @@ void AbstractFunction::initWithVectors(QVector<coeffpair> &in_coeffs, QVector<fr
 
 std::complex<double> zzbarFunction::bundle(double &x, double &y, unsigned int &i) const
 {
-    int N,M;
-    N = freqs[i].N();
-    M = freqs[i].M();
+    return term(x, y, freqs[i].N(), freqs[i].M());
+}
+
+std::complex<double> zzbarFunction::term(double x, double y, int N, int M) const
+{
     std::complex<double> ans(x , y);
     std::complex<double> ans2(x , y);
     ans=pow(ans,N);
@@ -157,26 +392,42 @@ std::complex<double> zzbarFunction::bundle(double &x, double &y, unsigned int &i
 
 }
 
-std::complex<double> zzbarFunction::operator ()(double i, double j)
+std::complex<double> zzbarFunction::evaluate(const FunctionPlan &plan, double i, double j) const
 {
+    // z^N and conj(z)^M = conj(z^M) come off one ladder shared by all terms
+    PowerLadder z(std::complex<double>(i, j), plan.powerMin, plan.powerMax);
+    
     std::complex<double> ans(0,0);
-    for(unsigned int k=0; k<terms; k++)
-    {
-        std::complex<double> thisterm = bundle(i, j, k);
-        thisterm *= coeffs[k].combined();
-        ans+= thisterm;
-    }
-    ans *= scale.combined();
+    for(int k = 0; k < plan.terms.size(); k++)
+        ans += plan.terms[k].coeff * z[plan.terms[k].n] * conj(z[plan.terms[k].m]);
+
     return ans;
 }
 
+void zzbarFunction::expand(FunctionPlan &plan) const
+{
+    plan.polar = true;
+    plan.direct = 1.0;
+    plan.reciprocal = 0.0;
+}
+
+// z^N conj(z)^M turns N-M times per turn of longitude and has no
+// oscillation in latitude; likewise for inv and neginv
+void zzbarFunction::termFrequencies(const PlanTerm &term, double *alongX, double *alongY) const
+{
+    *alongX = qAbs(term.n - term.m);
+    *alongY = 0.0;
+}
+
 ////////////////////////////////////////////////////////////
 
 std::complex<double> invFunction::bundle(double &x, double &y, unsigned int &i) const
 {
-    int N,M;
-    N = freqs[i].N();
-    M = freqs[i].M();
+    return term(x, y, freqs[i].N(), freqs[i].M());
+}
+
+std::complex<double> invFunction::term(double x, double y, int N, int M) const
+{
     std::complex<double> ans(x , y);
     std::complex<double> ans2(x , y);
     ans=pow(ans,N);
@@ -186,26 +437,57 @@ std::complex<double> invFunction::bundle(double &x, double &y, unsigned int &i)
 
 }
 
-std::complex<double> invFunction::operator ()(double i, double j)
+std::complex<double> invFunction::evaluate(const FunctionPlan &plan, double i, double j) const
 {
     std::complex<double> ans(0,0);
-    for(unsigned int k=0; k<terms; k++)
+    
+    // z = 0 has no reciprocal to build the negative powers from; there
+    // the terms go through term()'s complex pow, as they always did
+    if(i == 0.0 && j == 0.0)
     {
-        std::complex<double> thisterm = bundle(i, j, k);
-        thisterm *= coeffs[k].combined();
-        ans+= thisterm;
+        for(int k = 0; k < plan.terms.size(); k++)
+            ans += plan.terms[k].coeff * term(i, j, plan.terms[k].n, plan.terms[k].m);
+        return ans;
     }
-    ans *= scale.combined();
+    
+    // the ladder runs to the negated exponents as well, so the reciprocal
+    // of z^N conj(z)^M is just z^-N conj(z)^-M with no extra division
+    int reach = qMax(-plan.powerMin, plan.powerMax);
+    PowerLadder z(std::complex<double>(i, j), -reach, reach);
+    
+    for(int k = 0; k < plan.terms.size(); k++)
+    {
+        int N = plan.terms[k].n, M = plan.terms[k].m;
+        std::complex<double> power = z[N] * conj(z[M]);
+        std::complex<double> inverse = z[-N] * conj(z[-M]);
+        ans += plan.terms[k].coeff * (power + inverse) * 0.5;
+    }
+
     return ans;
 }
 
+void invFunction::expand(FunctionPlan &plan) const
+{
+    plan.polar = true;
+    plan.direct = 0.5;
+    plan.reciprocal = 0.5;
+}
+
+void invFunction::termFrequencies(const PlanTerm &term, double *alongX, double *alongY) const
+{
+    *alongX = qAbs(term.n - term.m);
+    *alongY = 0.0;
+}
+
 ////////////////////////////////////////////////////////////
 
 std::complex<double> neginvFunction::bundle(double &x, double &y, unsigned int &i) const
 {
-    int N,M;
-    N = freqs[i].N();
-    M = freqs[i].M();
+    return term(x, y, freqs[i].N(), freqs[i].M());
+}
+
+std::complex<double> neginvFunction::term(double x, double y, int N, int M) const
+{
     std::complex<double> ans(x , y);
     std::complex<double> ans2(x , y);
     ans=pow(ans,N);
@@ -215,19 +497,48 @@ std::complex<double> neginvFunction::bundle(double &x, double &y, unsigned int &
 
 }
 
-std::complex<double> neginvFunction::operator ()(double i, double j)
+std::complex<double> neginvFunction::evaluate(const FunctionPlan &plan, double i, double j) const
 {
     std::complex<double> ans(0,0);
-    for(unsigned int k=0; k<terms; k++)
+    
+    // z = 0 has no reciprocal to build the negative powers from; there
+    // the terms go through term()'s complex pow, as they always did
+    if(i == 0.0 && j == 0.0)
     {
-        std::complex<double> thisterm = bundle(i, j, k);
-        thisterm *= coeffs[k].combined();
-        ans+= thisterm;
+        for(int k = 0; k < plan.terms.size(); k++)
+            ans += plan.terms[k].coeff * term(i, j, plan.terms[k].n, plan.terms[k].m);
+        return ans;
     }
-    ans *= scale.combined();
+    
+    // the ladder runs to the negated exponents as well, so the reciprocal
+    // of z^N conj(z)^M is just z^-N conj(z)^-M with no extra division
+    int reach = qMax(-plan.powerMin, plan.powerMax);
+    PowerLadder z(std::complex<double>(i, j), -reach, reach);
+    
+    for(int k = 0; k < plan.terms.size(); k++)
+    {
+        int N = plan.terms[k].n, M = plan.terms[k].m;
+        std::complex<double> power = z[N] * conj(z[M]);
+        std::complex<double> inverse = z[-N] * conj(z[-M]);
+        ans += plan.terms[k].coeff * (power - inverse) * 0.5;
+    }
+
     return ans;
 }
 
+void neginvFunction::expand(FunctionPlan &plan) const
+{
+    plan.polar = true;
+    plan.direct = 0.5;
+    plan.reciprocal = -0.5;
+}
+
+void neginvFunction::termFrequencies(const PlanTerm &term, double *alongX, double *alongY) const
+{
+    *alongX = qAbs(term.n - term.m);
+    *alongY = 0.0;
+}
+
 ////////////////////////////////////////////////////////////
 
 //NOTE: 1. Use N-M even to create tetrahedral symmetry.
@@ -236,9 +547,12 @@ std::complex<double> neginvFunction::operator ()(double i, double j)
 
 std::complex<double> tetraFunction::bundle(double &x, double &y, unsigned int &i) const
 {
-    int N,M;
-    N = freqs[i].N();
-    M = freqs[i].M();std::complex<double> ans(1,0);
+    return term(x, y, freqs[i].N(), freqs[i].M());
+}
+
+std::complex<double> tetraFunction::term(double x, double y, int N, int M) const
+{
+    std::complex<double> ans(1,0);
     if(N==0){return ans;}
     else{
     std::complex<double> tmpz(x , y);
@@ -246,19 +560,28 @@ std::complex<double> tetraFunction::bundle(double &x, double &y, unsigned int &i
     return ans;};
 }
 
-std::complex<double> tetraFunction::operator ()(double i, double j)
+std::complex<double> tetraFunction::evaluate(const FunctionPlan &plan, double i, double j) const
 {
+    // the three points ave3 averages over, with their powers, serve every term
+    OrbitLadders orbit(std::complex<double>(i, j), tetrahedralOrbit(), qMax(-plan.powerMin, plan.powerMax));
+    
     std::complex<double> ans(0,0);
-    for(unsigned int k=0; k<terms; k++)
+    for(int k = 0; k < plan.terms.size(); k++)
     {
-        std::complex<double> thisterm = bundle(i, j, k);
-        thisterm *= coeffs[k].combined();
-        ans+= thisterm;
+        if(plan.terms[k].n == 0) ans += plan.terms[k].coeff;
+        else ans += plan.terms[k].coeff * orbit.ave2Mean(plan.terms[k].n, plan.terms[k].m);
     }
-    ans *= scale.combined();
+
     return ans;
 }
 
+// each rotated copy of z^N conj(z)^M turns N-M times around its own pole,
+// so the average oscillates about that often per radian in any direction
+void tetraFunction::termFrequencies(const PlanTerm &term, double *alongX, double *alongY) const
+{
+    *alongX = *alongY = term.n == 0 ? 0.0 : qAbs(term.n - term.m);
+}
+
 ////////////////////////////////////////////////////////////
 
 //NOTE: This one is T4a^3/T4b^3. N is the power of this function; M=1 now assigns the first twist
@@ -266,9 +589,12 @@ std::complex<double> tetraFunction::operator ()(double i, double j)
 
 std::complex<double> tetra3Function::bundle(double &x, double &y, unsigned int &i) const
 {
-    int N,M;
-    N = freqs[i].N();
-    M = freqs[i].M();std::complex<double> ans(1,0);
+    return term(x, y, freqs[i].N(), freqs[i].M());
+}
+
+std::complex<double> tetra3Function::term(double x, double y, int N, int M) const
+{
+    std::complex<double> ans(1,0);
     if(N==0){return ans;}
     else{
     std::complex<double> tmpz(x , y);
@@ -285,16 +611,28 @@ std::complex<double> tetra3Function::bundle(double &x, double &y, unsigned int &
 
 }
 
-std::complex<double> tetra3Function::operator ()(double i, double j)
+std::complex<double> tetra3Function::evaluate(const FunctionPlan &plan, double i, double j) const
 {
+    std::complex<double> z(i, j), num, den;
+    tetrahedralQuotient(z, 1.0, num, den);
+    
+    // T^3N untwisted and T^2N twisted both come off one ladder of T
+    PowerLadder t(num, den, 3 * plan.powerMin, 3 * plan.powerMax);
+    
+    std::complex<double> zc = conj(z);
+    std::complex<double> z3 = zc - z * z * z;
+    std::complex<double> z1 = Eye * q3 * z * (1.0 - zc * z);
+    std::complex<double> twist = (z3 + z1) / (z3 - z1);
+    
     std::complex<double> ans(0,0);
-    for(unsigned int k=0; k<terms; k++)
+    for(int k = 0; k < plan.terms.size(); k++)
     {
-        std::complex<double> thisterm = bundle(i, j, k);
-        thisterm *= coeffs[k].combined();
-        ans+= thisterm;
+        int N = plan.terms[k].n;
+        if(N == 0) ans += plan.terms[k].coeff;
+        else if(plan.terms[k].m == 0) ans += plan.terms[k].coeff * t[3 * N];
+        else ans += plan.terms[k].coeff * t[2 * N] * twist;
     }
-    ans *= scale.combined();
+
     return ans;
 }
 
@@ -304,9 +642,11 @@ std::complex<double> tetra3Function::operator ()(double i, double j)
 
 std::complex<double> tetraColFunction::bundle(double &x, double &y, unsigned int &i) const
 {
-    int N,M;
-    N = freqs[i].N();
-    M = freqs[i].M();
+    return term(x, y, freqs[i].N(), freqs[i].M());
+}
+
+std::complex<double> tetraColFunction::term(double x, double y, int N, int M) const
+{
     std::complex<double> tmpz(x , y);
     std::complex<double> z4=pow(tmpz,4)+1.0;
     std::complex<double> z2=pow(tmpz,2)*Eye*2.0*q3;
@@ -314,16 +654,16 @@ std::complex<double> tetraColFunction::bundle(double &x, double &y, unsigned int
     return ans;
 }
 
-std::complex<double> tetraColFunction::operator ()(double i, double j)
+std::complex<double> tetraColFunction::evaluate(const FunctionPlan &plan, double i, double j) const
 {
+    std::complex<double> num, den;
+    tetrahedralQuotient(std::complex<double>(i, j), 1.0, num, den);
+    PowerLadder t(num, den, plan.powerMin, plan.powerMax);
+    
     std::complex<double> ans(0,0);
-    for(unsigned int k=0; k<terms; k++)
-    {
-        std::complex<double> thisterm = bundle(i, j, k);
-        thisterm *= coeffs[k].combined();
-        ans+= thisterm;
-    }
-    ans *= scale.combined();
+    for(int k = 0; k < plan.terms.size(); k++)
+        ans += plan.terms[k].coeff * t[plan.terms[k].n];
+
     return ans;
 }
 
@@ -333,36 +673,44 @@ std::complex<double> tetraColFunction::operator ()(double i, double j)
 
 std::complex<double> icosFunction::bundle(double &x, double &y, unsigned int &i) const
 {
-    int N,M;
-    N = freqs[i].N();
-    M = freqs[i].M();
+    return term(x, y, freqs[i].N(), freqs[i].M());
+}
+
+std::complex<double> icosFunction::term(double x, double y, int N, int M) const
+{
     std::complex<double> tmpz(x , y);
     std::complex<double> ans=ave5(tmpz,N,M);
     return ans;
 }
 
-std::complex<double> icosFunction::operator ()(double i, double j)
+std::complex<double> icosFunction::evaluate(const FunctionPlan &plan, double i, double j) const
 {
+    // the fifteen points ave5 averages over, with their powers, serve every term
+    OrbitLadders orbit(std::complex<double>(i, j), icosahedralOrbit(), qMax(-plan.powerMin, plan.powerMax));
+    
     std::complex<double> ans(0,0);
-    for(unsigned int k=0; k<terms; k++)
-    {
-        std::complex<double> thisterm = bundle(i, j, k);
-        thisterm *= coeffs[k].combined();
-        ans+= thisterm;
-    }
-    ans *= scale.combined();
+    for(int k = 0; k < plan.terms.size(); k++)
+        ans += plan.terms[k].coeff * orbit.ave2Mean(plan.terms[k].n, plan.terms[k].m);
+
     return ans;
 }
 
+void icosFunction::termFrequencies(const PlanTerm &term, double *alongX, double *alongY) const
+{
+    *alongX = *alongY = qAbs(term.n - term.m);
+}
+
 ////////////////////////////////////////////////////////////
 
 //NOTE: This one is  (T4a^3/T4b^3)^N averaged over 5-fold rotation
 
-std::complex<double>  icos3Function::bundle(double &x, double &y, unsigned int &i) const
+std::complex<double> icos3Function::bundle(double &x, double &y, unsigned int &i) const
+{
+    return term(x, y, freqs[i].N(), freqs[i].M());
+}
+
+std::complex<double> icos3Function::term(double x, double y, int N, int M) const
 {
-    int N,M;
-    N = freqs[i].N();
-    M = freqs[i].M();
     std::complex<double> tmpz(x , y);
     std::complex<double> z4=pow(tmpz,4)+1.0;
     std::complex<double> z2=pow(tmpz,2)*Eye*2.0*q3;
@@ -386,110 +734,134 @@ std::complex<double>  icos3Function::bundle(double &x, double &y, unsigned int &
     return (ans1+ans2+ans3+ans4+ans5)/5.0;
 }
 
-std::complex<double> icos3Function::operator ()(double i, double j)
+std::complex<double> icos3Function::evaluate(const FunctionPlan &plan, double i, double j) const
 {
+    const QVector<Mobius> &maps = fiveFoldOrbit();
+    
+    // one ladder of T^3 per rotated point; rho5 sending a point to infinity
+    // is no special case in homogeneous form
     std::complex<double> ans(0,0);
-    for(unsigned int k=0; k<terms; k++)
+    for(int r = 0; r < maps.size(); r++)
     {
-        std::complex<double> thisterm = bundle(i, j, k);
-        thisterm *= coeffs[k].combined();
-        ans+= thisterm;
+        std::complex<double> p, q, num, den;
+        maps[r].apply(std::complex<double>(i, j), p, q);
+        tetrahedralQuotient(p, q, num, den);
+        PowerLadder t(num * num * num, den * den * den, plan.powerMin, plan.powerMax);
+        
+        for(int k = 0; k < plan.terms.size(); k++)
+            ans += plan.terms[k].coeff * t[plan.terms[k].n];
     }
-    ans *= scale.combined();
-    return ans;
+
+    return ans / double(maps.size());
 }
 
 ////////////////////////////////////////////////////////////
 
 std::complex<double> tetraMFunction::bundle(double &x, double &y, unsigned int &i) const
 {
-    int N,M;
-    N = freqs[i].N();
-    M = freqs[i].M();
+    return term(x, y, freqs[i].N(), freqs[i].M());
+}
+
+std::complex<double> tetraMFunction::term(double x, double y, int N, int M) const
+{
     std::complex<double> tmpz(x , y);
     std::complex<double> ans=ave3(tmpz,N,M);
      std::complex<double> ans1=ave3(tmpz,M,N);
     return (ans+ans1)/2.0;
 }
 
-std::complex<double> tetraMFunction::operator ()(double i, double j)
+std::complex<double> tetraMFunction::evaluate(const FunctionPlan &plan, double i, double j) const
 {
+    OrbitLadders orbit(std::complex<double>(i, j), tetrahedralOrbit(), qMax(-plan.powerMin, plan.powerMax));
+    
     std::complex<double> ans(0,0);
-    for(unsigned int k=0; k<terms; k++)
+    for(int k = 0; k < plan.terms.size(); k++)
     {
-        std::complex<double> thisterm = bundle(i, j, k);
-        thisterm *= coeffs[k].combined();
-        ans+= thisterm;
+        int N = plan.terms[k].n, M = plan.terms[k].m;
+        ans += plan.terms[k].coeff * (orbit.ave2Mean(N, M) + orbit.ave2Mean(M, N)) / 2.0;
     }
-    ans *= scale.combined();
+
     return ans;
 }
-/*
+
+void tetraMFunction::termFrequencies(const PlanTerm &term, double *alongX, double *alongY) const
+{
+    *alongX = *alongY = qAbs(term.n - term.m);
+}
 ////////////////////////////////////////////////////////////
 
-//NOTE: Some of the spherical harmonics seem to average to zero. Investigate!
+//NOTE: Some of the spherical harmonics average to zero; expandHarmonics() drops them.
 
 std::complex<double> tetraHFunction::bundle(double &x, double &y, unsigned int &i) const
 {
-    int N,M;
-    N = freqs[i].N();
-    M = freqs[i].M();
+    return term(x, y, freqs[i].N(), freqs[i].M());
+}
+
+std::complex<double> tetraHFunction::term(double x, double y, int N, int M) const
+{
     std::complex<double> tmpz(x , y);
     std::complex<double> ans=ave3H(tmpz,N,M);
     //std::complex<double> ans=Htest(tmpz,N,M);
     return ans;
 }
 
-std::complex<double> tetraHFunction::operator ()(double i, double j)
+std::complex<double> tetraHFunction::evaluate(const FunctionPlan &plan, double i, double j) const
 {
-    std::complex<double> ans(0,0);
-    for(unsigned int k=0; k<terms; k++)
-    {
-        std::complex<double> thisterm = bundle(i, j, k);
-        thisterm *= coeffs[k].combined();
-        ans+= thisterm;
-    }
-    ans *= scale.combined();
-    return ans;
+    return evaluateHarmonics(plan, i, j);
+}
+
+void tetraHFunction::expand(FunctionPlan &plan) const
+{
+    expandHarmonics(plan, tetrahedralOrbit());
+}
+
+void tetraHFunction::termFrequencies(const PlanTerm &term, double *alongX, double *alongY) const
+{
+    harmonicFrequencies(term, alongX, alongY);
 }
 
 ////////////////////////////////////////////////////////////
 
-//NOTE: Some of the spherical harmonics seem to average to zero. Investigate!
+//NOTE: Some of the spherical harmonics average to zero; expandHarmonics() drops them.
 
 std::complex<double> icosHFunction::bundle(double &x, double &y, unsigned int &i) const
 {
-    int N,M;
-    N = freqs[i].N();
-    M = freqs[i].M();
+    return term(x, y, freqs[i].N(), freqs[i].M());
+}
+
+std::complex<double> icosHFunction::term(double x, double y, int N, int M) const
+{
     std::complex<double> tmpz(x , y);
     std::complex<double> ans=ave5H(tmpz,N,M);
     //std::complex<double> ans=Htest(tmpz,N,M);
     return ans;
 }
 
-std::complex<double> icosHFunction::operator ()(double i, double j)
+std::complex<double> icosHFunction::evaluate(const FunctionPlan &plan, double i, double j) const
 {
-    std::complex<double> ans(0,0);
-    for(unsigned int k=0; k<terms; k++)
-    {
-        std::complex<double> thisterm = bundle(i, j, k);
-        thisterm *= coeffs[k].combined();
-        ans+= thisterm;
-    }
-    ans *= scale.combined();
-    return ans;
+    return evaluateHarmonics(plan, i, j);
+}
+
+void icosHFunction::expand(FunctionPlan &plan) const
+{
+    expandHarmonics(plan, icosahedralOrbit());
+}
+
+void icosHFunction::termFrequencies(const PlanTerm &term, double *alongX, double *alongY) const
+{
+    harmonicFrequencies(term, alongX, alongY);
 }
 
 ////////////////////////////////////////////////////////////
-*/
 //NOTE: This one is P20^3N over P12^5N. So poles at the 5 centers.
 
 std::complex<double> icos5Function::bundle(double &x, double &y, unsigned int &i) const
 {
-    int N,M;
-    N = freqs[i].N();
-    M = freqs[i].M();
+    return term(x, y, freqs[i].N(), freqs[i].M());
+}
+
+std::complex<double> icos5Function::term(double x, double y, int N, int M) const
+{
     std::complex<double> ans(1,0);
     if(N==0){return ans;}
     else{
@@ -498,16 +870,29 @@ std::complex<double> icos5Function::bundle(double &x, double &y, unsigned int &i
     return ans;};
 }
 
-std::complex<double> icos5Function::operator ()(double i, double j)
+std::complex<double> icos5Function::evaluate(const FunctionPlan &plan, double i, double j) const
 {
+    // P20^3N P12^-5N = (P20^3 / P12^5)^N, with the invariants taken once per pixel
+    std::complex<double> z(i, j);
+    std::complex<double> p12 = P12(z), p20 = P20(z);
     std::complex<double> ans(0,0);
-    for(unsigned int k=0; k<terms; k++)
+    
+    // at the 12 pole centers (P12 = 0) and the zeros of P20 the quotient
+    // has no finite powers; there the terms go through term()'s complex
+    // pow, as they always did
+    if(p12 == 0.0 || p20 == 0.0)
     {
-        std::complex<double> thisterm = bundle(i, j, k);
-        thisterm *= coeffs[k].combined();
-        ans+= thisterm;
+        for(int k = 0; k < plan.terms.size(); k++)
+            ans += plan.terms[k].coeff * term(i, j, plan.terms[k].n, plan.terms[k].m);
+        return ans;
     }
-    ans *= scale.combined();
+    
+    std::complex<double> p12Squared = p12 * p12;
+    PowerLadder r(p20 * p20 * p20, p12Squared * p12Squared * p12, plan.powerMin, plan.powerMax);
+    
+    for(int k = 0; k < plan.terms.size(); k++)
+        ans += plan.terms[k].coeff * r[plan.terms[k].n];
+
     return ans;
 }
 
@@ -517,9 +902,11 @@ std::complex<double> icos5Function::operator ()(double i, double j)
 
 std::complex<double> icos30Function::bundle(double &x, double &y, unsigned int &i) const
 {
-    int N,M;
-    N = freqs[i].N();
-    M = freqs[i].M();
+    return term(x, y, freqs[i].N(), freqs[i].M());
+}
+
+std::complex<double> icos30Function::term(double x, double y, int N, int M) const
+{
     std::complex<double> ans(1,0);
     if(N==0){return ans;}
     else{
@@ -528,16 +915,27 @@ std::complex<double> icos30Function::bundle(double &x, double &y, unsigned int &
     return ans;
 }
 
-std::complex<double> icos30Function::operator ()(double i, double j)
+std::complex<double> icos30Function::evaluate(const FunctionPlan &plan, double i, double j) const
 {
+    // P30^2N P12^-5N = (P30^2 / P12^5)^N
+    std::complex<double> z(i, j);
+    std::complex<double> p12 = P12(z), p30 = P30(z);
     std::complex<double> ans(0,0);
-    for(unsigned int k=0; k<terms; k++)
+    
+    // likewise at the pole centers and the zeros of P30
+    if(p12 == 0.0 || p30 == 0.0)
     {
-        std::complex<double> thisterm = bundle(i, j, k);
-        thisterm *= coeffs[k].combined();
-        ans+= thisterm;
+        for(int k = 0; k < plan.terms.size(); k++)
+            ans += plan.terms[k].coeff * term(i, j, plan.terms[k].n, plan.terms[k].m);
+        return ans;
     }
-    ans *= scale.combined();
+    
+    std::complex<double> p12Squared = p12 * p12;
+    PowerLadder r(p30 * p30, p12Squared * p12Squared * p12, plan.powerMin, plan.powerMax);
+    
+    for(int k = 0; k < plan.terms.size(); k++)
+        ans += plan.terms[k].coeff * r[plan.terms[k].n];
+
     return ans;
 }
 
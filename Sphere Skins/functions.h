@@ -10,6 +10,53 @@
 #include "pairs.h"
 #include "geomath.h"
 #include "display.h"
+#include "polyhedral.h"
+
+// attenuated terms of a draft render below this fraction of the largest
+// coefficient are dropped (see AbstractFunction::limitDetail)
+const double DETAIL_THRESHOLD = 1.0 / 256;
+
+// one term of a compiled function: its coefficient with the function's
+// global scale already multiplied in, plus its frequency pair
+struct PlanTerm
+{
+    std::complex<double> coeff;
+    int n;
+    int m;
+};
+
+// flat, read-only snapshot of a function's terms. Built once per render job
+// by AbstractFunction::compile() so the per-pixel loop never touches the
+// coeffpair/freqpair vectors or recomputes coeffs[k].combined()
+//
+// powerMin..powerMax span the terms' n and m (and always include 0)
+//
+// For zzbar, inv and neginv, expand() also marks the plan as polar: with
+// z = r e^(i theta) each of their terms is
+//     coeff * (direct * r^(n+m) e^(i(n-m)theta) + reciprocal * r^-(n+m) e^(-i(n-m)theta))
+// which splits into a radial and an angular factor (see PolarTables)
+//
+// The spherical-harmonic families (tetraH, icosH) are polar and harmonic: their
+// expand() rewrites the group-averaged terms as harmonics at the point itself,
+//     f = sum_j harmonics[j].coeff * P_l^|m|(zee) e^(i m theta)
+// with l = harmonics[j].n, m = harmonics[j].m, zee = (1 - r^2) / (1 + r^2),
+// and harmonicDegree the largest l
+//
+// Every family is linear in its coefficients: f = sum_k terms[k].coeff * b_k,
+// where b_k is what compileTerm(k) evaluates to. compileTerms() stops short
+// of expand() and only lists the terms, which is all a caller holding the
+// b_k (see BasisCache) needs
+struct FunctionPlan
+{
+    QVector<PlanTerm> terms;
+    int powerMin = 0, powerMax = 0;
+    
+    bool polar = false;
+    double direct = 1.0, reciprocal = 0.0;
+    bool harmonic = false;
+    QVector<PlanTerm> harmonics;
+    int harmonicDegree = 0;
+};
 
 class AbstractFunction      //this is the base class for all other classes that follow in this file;
 {                           //it defines many of the member functions that we needed for all of the
@@ -24,7 +71,14 @@ public:                   //derived classes
     // CONST MEMBER FUNCTIONS
     int getNumTerms() { return terms; }
     virtual std::complex<double> bundle(double &x, double &y, unsigned int &i) const = 0;
-    virtual std::complex<double> operator() (double i, double j) = 0;
+    virtual std::complex<double> evaluate(const FunctionPlan &plan, double i, double j) const = 0;
+    std::complex<double> operator() (double i, double j) const { return evaluate(compile(), i, j); }
+    FunctionPlan compile() const;
+    FunctionPlan compileTerms() const;
+    FunctionPlan compileTerm(unsigned int k) const;
+    FunctionPlan compile(const FunctionPlan &terms) const;
+    int limitDetail(FunctionPlan &terms, double xPitch, double yPitch) const;
+    void evaluateBatch(const FunctionPlan &plan, const double *x, const double *y, int count, double *re, double *im) const;
     int getN(unsigned int &i) const;
     int getM(unsigned int &i) const;
     double getR(unsigned int &i) const;
@@ -56,6 +110,14 @@ protected:
     
     // PRIVATE MEMBER FUNCTIONS
     void initWithVectors(QVector<coeffpair> &in_coeffs, QVector<freqpair> &in_freqs);
+    virtual void expand(FunctionPlan & /* unused */) const { }
+    std::complex<double> evaluateHarmonics(const FunctionPlan &plan, double x, double y) const;
+    static void expandHarmonics(FunctionPlan &plan, const QVector<Mobius> &orbit);
+    
+    // how many radians a term's phase turns per radian of longitude (x) and
+    // of latitude (y) at most, for limitDetail(); 0 where it is not known
+    virtual void termFrequencies(const PlanTerm & /* unused */, double *alongX, double *alongY) const { *alongX = *alongY = 0.0; }
+    static void harmonicFrequencies(const PlanTerm &term, double *alongX, double *alongY);
 };
 
 
@@ -71,7 +133,10 @@ public:
     zzbarFunction(QVector<coeffpair> in_coeffs, QVector<freqpair> in_freqs) {initWithVectors(in_coeffs, in_freqs);}
 
     std::complex<double> bundle(double &x, double &y, unsigned int &i) const;
-    std::complex<double> operator() (double i, double j);
+    std::complex<double> evaluate(const FunctionPlan &plan, double i, double j) const;
+    std::complex<double> term(double x, double y, int N, int M) const;
+    void expand(FunctionPlan &plan) const;
+    void termFrequencies(const PlanTerm &term, double *alongX, double *alongY) const;
 
     virtual AbstractFunction* clone() const { return new zzbarFunction(*this); }
 
@@ -89,7 +154,10 @@ class invFunction : public AbstractFunction
     invFunction(QVector<coeffpair> in_coeffs, QVector<freqpair> in_freqs) {initWithVectors(in_coeffs, in_freqs);}
 
     std::complex<double> bundle(double &x, double &y, unsigned int &i) const;
-    std::complex<double> operator() (double i, double j);
+    std::complex<double> evaluate(const FunctionPlan &plan, double i, double j) const;
+    std::complex<double> term(double x, double y, int N, int M) const;
+    void expand(FunctionPlan &plan) const;
+    void termFrequencies(const PlanTerm &term, double *alongX, double *alongY) const;
 
     virtual AbstractFunction* clone() const{return new invFunction(*this);}
 
@@ -107,7 +175,10 @@ class neginvFunction : public AbstractFunction
     neginvFunction(QVector<coeffpair> in_coeffs, QVector<freqpair> in_freqs) {initWithVectors(in_coeffs, in_freqs);}
 
     std::complex<double> bundle(double &x, double &y, unsigned int &i) const;
-    std::complex<double> operator() (double i, double j);
+    std::complex<double> evaluate(const FunctionPlan &plan, double i, double j) const;
+    std::complex<double> term(double x, double y, int N, int M) const;
+    void expand(FunctionPlan &plan) const;
+    void termFrequencies(const PlanTerm &term, double *alongX, double *alongY) const;
 
     virtual AbstractFunction* clone() const{return new neginvFunction(*this);}
 
@@ -125,7 +196,9 @@ class tetraFunction : public AbstractFunction
     tetraFunction(QVector<coeffpair> in_coeffs, QVector<freqpair> in_freqs) {initWithVectors(in_coeffs, in_freqs);}
 
     std::complex<double> bundle(double &x, double &y, unsigned int &i) const;
-    std::complex<double> operator() (double i, double j);
+    std::complex<double> evaluate(const FunctionPlan &plan, double i, double j) const;
+    std::complex<double> term(double x, double y, int N, int M) const;
+    void termFrequencies(const PlanTerm &term, double *alongX, double *alongY) const;
 
     virtual AbstractFunction* clone() const{return new tetraFunction(*this);}
 };
@@ -142,7 +215,8 @@ class tetra3Function : public AbstractFunction
     tetra3Function(QVector<coeffpair> in_coeffs, QVector<freqpair> in_freqs) {initWithVectors(in_coeffs, in_freqs);}
 
     std::complex<double> bundle(double &x, double &y, unsigned int &i) const;
-    std::complex<double> operator() (double i, double j);
+    std::complex<double> evaluate(const FunctionPlan &plan, double i, double j) const;
+    std::complex<double> term(double x, double y, int N, int M) const;
 
     virtual AbstractFunction* clone() const{return new tetra3Function(*this);}
 };
@@ -159,7 +233,8 @@ class tetraColFunction : public AbstractFunction
     tetraColFunction(QVector<coeffpair> in_coeffs, QVector<freqpair> in_freqs) {initWithVectors(in_coeffs, in_freqs);}
 
     std::complex<double> bundle(double &x, double &y, unsigned int &i) const;
-    std::complex<double> operator() (double i, double j);
+    std::complex<double> evaluate(const FunctionPlan &plan, double i, double j) const;
+    std::complex<double> term(double x, double y, int N, int M) const;
 
     virtual AbstractFunction* clone() const{return new tetraColFunction(*this);}
 };
@@ -176,7 +251,9 @@ class tetraMFunction : public AbstractFunction
     tetraMFunction(QVector<coeffpair> in_coeffs, QVector<freqpair> in_freqs) {initWithVectors(in_coeffs, in_freqs);}
 
     std::complex<double> bundle(double &x, double &y, unsigned int &i) const;
-    std::complex<double> operator() (double i, double j);
+    std::complex<double> evaluate(const FunctionPlan &plan, double i, double j) const;
+    std::complex<double> term(double x, double y, int N, int M) const;
+    void termFrequencies(const PlanTerm &term, double *alongX, double *alongY) const;
 
     virtual AbstractFunction* clone() const{return new tetraMFunction(*this);}
 };
@@ -193,7 +270,9 @@ class icosFunction : public AbstractFunction
     icosFunction(QVector<coeffpair> in_coeffs, QVector<freqpair> in_freqs) {initWithVectors(in_coeffs, in_freqs);}
 
     std::complex<double> bundle(double &x, double &y, unsigned int &i) const;
-    std::complex<double> operator() (double i, double j);
+    std::complex<double> evaluate(const FunctionPlan &plan, double i, double j) const;
+    std::complex<double> term(double x, double y, int N, int M) const;
+    void termFrequencies(const PlanTerm &term, double *alongX, double *alongY) const;
 
     virtual AbstractFunction* clone() const{return new icosFunction(*this);}
 };
@@ -210,7 +289,8 @@ class icos3Function : public AbstractFunction
     icos3Function(QVector<coeffpair> in_coeffs, QVector<freqpair> in_freqs) {initWithVectors(in_coeffs, in_freqs);}
 
     std::complex<double> bundle(double &x, double &y, unsigned int &i) const;
-    std::complex<double> operator() (double i, double j);
+    std::complex<double> evaluate(const FunctionPlan &plan, double i, double j) const;
+    std::complex<double> term(double x, double y, int N, int M) const;
 
     virtual AbstractFunction* clone() const{return new icos3Function(*this);}
 };
@@ -227,7 +307,8 @@ class icos5Function : public AbstractFunction
     icos5Function(QVector<coeffpair> in_coeffs, QVector<freqpair> in_freqs) {initWithVectors(in_coeffs, in_freqs);}
 
     std::complex<double> bundle(double &x, double &y, unsigned int &i) const;
-    std::complex<double> operator() (double i, double j);
+    std::complex<double> evaluate(const FunctionPlan &plan, double i, double j) const;
+    std::complex<double> term(double x, double y, int N, int M) const;
 
     virtual AbstractFunction* clone() const{return new icos5Function(*this);}
 
@@ -245,12 +326,12 @@ class icos30Function : public AbstractFunction
     icos30Function(QVector<coeffpair> in_coeffs, QVector<freqpair> in_freqs) {initWithVectors(in_coeffs, in_freqs);}
 
     std::complex<double> bundle(double &x, double &y, unsigned int &i) const;
-    std::complex<double> operator() (double i, double j);
+    std::complex<double> evaluate(const FunctionPlan &plan, double i, double j) const;
+    std::complex<double> term(double x, double y, int N, int M) const;
 
     virtual AbstractFunction* clone() const{return new icos30Function(*this);}
 };
 
-/*
 ///////////////////////////////////////////////////////////////
 
 //Tetrahedral symmetry done with spherical harmonics
@@ -263,7 +344,10 @@ class tetraHFunction : public AbstractFunction
     tetraHFunction(QVector<coeffpair> in_coeffs, QVector<freqpair> in_freqs) {initWithVectors(in_coeffs, in_freqs);}
 
     std::complex<double> bundle(double &x, double &y, unsigned int &i) const;
-    std::complex<double> operator() (double i, double j);
+    std::complex<double> evaluate(const FunctionPlan &plan, double i, double j) const;
+    std::complex<double> term(double x, double y, int N, int M) const;
+    void expand(FunctionPlan &plan) const;
+    void termFrequencies(const PlanTerm &term, double *alongX, double *alongY) const;
 
     virtual AbstractFunction* clone() const{return new tetraHFunction(*this);}
 
@@ -281,13 +365,13 @@ class icosHFunction : public AbstractFunction
     icosHFunction(QVector<coeffpair> in_coeffs, QVector<freqpair> in_freqs) {initWithVectors(in_coeffs, in_freqs);}
 
     std::complex<double> bundle(double &x, double &y, unsigned int &i) const;
-    std::complex<double> operator() (double i, double j);
+    std::complex<double> evaluate(const FunctionPlan &plan, double i, double j) const;
+    std::complex<double> term(double x, double y, int N, int M) const;
+    void expand(FunctionPlan &plan) const;
+    void termFrequencies(const PlanTerm &term, double *alongX, double *alongY) const;
 
     virtual AbstractFunction* clone() const{return new icosHFunction(*this);}
 
 };
 
-///////////////////////////////////////////////////////////////
-
-*/
 #endif // FUNCTIONS_H
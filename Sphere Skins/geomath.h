@@ -7,6 +7,8 @@
 #include <QColor>
 #include <QDebug>
 
+#include "legendre.h"
+
 const double pi = 3.1415926535;
 const int deg = 3;
 const double rx[deg] = {1.0,-2.0,1.0};
@@ -269,61 +271,12 @@ We're using M from interface for HALF of degree and N from interface as HALF of
 
 inline std::complex<double> Leg(std::complex<double> in, int nin, int min)
 {
-    double xv =in.real(); double yv= in.imag();double ans;
+    double xv =in.real(); double yv= in.imag();
     double ra2=xv*xv+yv*yv;
-    double ra=qSqrt(ra2);
-    double phi=pi-qAtan2(2.0*ra, ra2-1.0);
+    double zee=(1.0-ra2)/(1.0+ra2);
     double theta=qAtan2(yv,xv);
-    double zee=qCos(phi);
-    double s=1-zee*zee;
-    if (nin<0||nin>2){
-        ans=2.0;}
-    else{
-        if(min<0||min<nin){
-            ans=-1.0;}
-        else{
-            switch(nin){
-                case 0:
-                    switch(min){
-                        case 0: ans=1.0;
-                                break;
-                        case 1: ans = (3.0*zee*zee-1.0)/2.0;
-                                break;
-                        case 2: ans= ( 35.0*pow(zee,4) -  30.0*pow(zee,2) +   3.0)/8.0;
-                                break;
-                        case 3: ans= ( 231.0*pow(zee,6) - 315.0*pow(zee,4)+ 105.0*pow(zee,2)-   5.0)/16.0;
-                                break;
-                    }
-                    break;
-                case 1:
-                    switch(min){
-                        case 0: ans=0.0;
-                                break;
-                        case 1: ans = 3.0*s;
-                                break;
-                        case 2: ans= 7.5*s*(7*pow(zee,2)-1);
-                                break;
-                        case 3: ans= 105.0*s*(33.0*pow(zee,4)-18*pow(zee,2)+1)/8.0;
-                                break;
-                    }
-                    break;
-                case 2:
-                    switch(min){
-                        case 0: ans=0.0;
-                                break;
-                        case 1: ans = 0.0;
-                                break;
-                        case 2: ans= 105.0 * pow(s,2);
-                                break;
-                        case 3: ans= 945.0*pow(s,4)*(11.0*zee*zee-1)/2.0;
-                                break;
-                    }
-                break;
-            }
-        }
-    }
-    //Remember that N was really 2N
-    std::complex<double> ansH = qCos(2*nin*theta)*ans;
+    //Remember that N was really 2N, and M really 2M
+    std::complex<double> ansH = qCos(2*nin*theta)*associatedLegendre(2*min,2*nin,zee);
     return ansH;
 }
 
@@ -18,6 +18,11 @@ Interface::Interface(QWidget *parent) : QWidget(parent)
     termIndex = 0;
     saveloadPath = QDir::homePath();
     errPrint = false;
+    lastPreviewRequest = -1;
+    previewStarted = 0;
+    previewStep = 1;
+    previewInFlight = false;
+    previewClock.start();
     
     // FUNCTIONAL OBJECTS
     functionVector.push_back(new zzbarFunction());
@@ -31,6 +36,8 @@ Interface::Interface(QWidget *parent) : QWidget(parent)
     functionVector.push_back(new tetraColFunction());
     functionVector.push_back(new invFunction());
     functionVector.push_back(new neginvFunction());
+    functionVector.push_back(new tetraHFunction());
+    functionVector.push_back(new icosHFunction());
     currFunction = functionVector[0];
     currColorWheel = new ColorWheel();
 
@@ -178,10 +185,19 @@ void Interface::initPreviewDisplay()
     displayProgressBar->setPermanentVisibility(false);
     exportProgressBar->setPermanentVisibility(true);
     
+    skippedTermsLabel = new QLabel(displayWidget);
+    skippedTermsLabel->setAlignment(Qt::AlignCenter);
+    skippedTermsLabel->setVisible(false);
+    
+    previewSettleTimer = new QTimer(this);
+    previewSettleTimer->setSingleShot(true);
+    previewSettleTimer->setInterval(PREVIEW_SETTLE_INTERVAL);
+    
     dispLayout->setAlignment(disp, Qt::AlignCenter);
     dispLayout->addWidget(disp);
     dispLayout->addLayout(displayProgressBar->layout);
     dispLayout->addLayout(buttonLayout);
+    dispLayout->addWidget(skippedTermsLabel);
     dispLayout->addStretch();
 }
 
@@ -411,6 +427,8 @@ void Interface::initPatternType()
     functionSel->addItem("Tetra 3-Color");
     functionSel->addItem("Inversion Sym");
     functionSel->addItem("Negative Inversion Sym");
+    functionSel->addItem("Tetra Harmonics");
+    functionSel->addItem("Icos Harmonics");
     
     // color wheel selector
     colorwheelSel->addItem("ImageSquish");
@@ -729,11 +747,14 @@ void Interface::connectAllSignals()
 
     connect(previewDisplayPort->getControllerObject(), SIGNAL(partialProgressChanged(double)), displayProgressBar, SLOT(partialUpdate(double)));
     connect(previewDisplayPort, SIGNAL(paintingFinished(bool)), this, SLOT(resetMainWindowButton(bool)));
+    connect(previewDisplayPort, SIGNAL(paintingFinished(bool)), this, SLOT(recordPreviewFrame()));
+    connect(previewSettleTimer, SIGNAL(timeout()), this, SLOT(settlePreview()));
     connect(displayProgressBar, SIGNAL(renderFinished()), this, SLOT(resetTableButton()));
     connect(imageExportPort, SIGNAL(finishedExport(QString)), this, SLOT(popUpImageExportFinished(QString)));
     connect(imageExportPort->getControllerObject(), SIGNAL(partialProgressChanged(double)), exportProgressBar, SLOT(partialUpdate(double)));
     qRegisterMetaType<ComplexValue>("ComplexValue");
     connect(previewDisplayPort->getControllerObject(), SIGNAL(newImageDataPoint(ComplexValue)), this, SLOT(addNewImageDataPoint(ComplexValue)));
+    connect(previewDisplayPort->getControllerObject(), SIGNAL(termsSkipped(int)), this, SLOT(updateSkippedTerms(int)));
     
     //shortcut
     connect(updatePreviewShortcut, SIGNAL(activated()), this, SLOT(snapshotFunction()));
@@ -1409,16 +1430,68 @@ void Interface::updatePreviewDisplay()
         return;
     }
     
+    // edits that come in less than PREVIEW_SETTLE_INTERVAL apart are one
+    // interaction (dragging, scrubbing, panning); its frames are drawn only
+    // as fine as fits in the frame budget, and a full-quality one follows
+    // once it stops
+    qint64 now = previewClock.elapsed();
+    bool interacting = lastPreviewRequest >= 0 && now - lastPreviewRequest < PREVIEW_SETTLE_INTERVAL;
+    lastPreviewRequest = now;
+    
+    if (!interacting) {
+        renderPreview(1);
+        return;
+    }
+    
+    FrameGovernor::Combination combination(functionSel->currentIndex(), colorwheelSel->currentIndex());
+    int pixels = disp->getWidth() * disp->getHeight();
+    
+    // the frame this one supersedes ran for at least this long
+    if (previewInFlight)
+        frameGovernor.recordFrame(combination, previewStep, pixels, currFunction->getNumTerms(),
+                                  now - previewStarted, false);
+    
+    previewSettleTimer->start();
+    renderPreview(frameGovernor.interactiveStep(combination, pixels, currFunction->getNumTerms()));
+}
+
+void Interface::renderPreview(int finestStep)
+{
     imageDataSeries->clear();
     
     snapshotButton->setEnabled(false);
     
+    previewStep = finestStep;
+    previewStarted = previewClock.elapsed();
+    previewInFlight = true;
+    
     displayProgressBar->reset();
-    previewDisplayPort->paintToDisplay(disp);
+    previewDisplayPort->paintToDisplay(disp, finestStep);
     updateAspectRatio();
     
 }
 
+// times the frame that just reached the preview
+void Interface::recordPreviewFrame()
+{
+    if (!previewInFlight) {
+        return;
+    }
+    
+    previewInFlight = false;
+    FrameGovernor::Combination combination(functionSel->currentIndex(), colorwheelSel->currentIndex());
+    frameGovernor.recordFrame(combination, previewStep, disp->getWidth() * disp->getHeight(),
+                              currFunction->getNumTerms(), previewClock.elapsed() - previewStarted, true);
+}
+
+// the interaction has stopped; draws its last state at full quality
+void Interface::settlePreview()
+{
+    if (previewStep > 1) {
+        renderPreview(1);
+    }
+}
+
 // slot function called when clicked "update preview" button to add to history and update the preview display to reflect current settings
 void Interface::snapshotFunction()
 {
@@ -1615,9 +1688,7 @@ void Interface::startImageExport()
     
     dispLayout->insertLayout(2, exportProgressBar->layout);
     
-    QImage *output = new QImage(settings->OWidth, settings->OHeight, QImage::Format_RGB32);
-    
-    imageExportPort->exportImage(output, fileName);
+    imageExportPort->exportImage(fileName);
     
 }
 
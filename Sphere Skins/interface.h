@@ -35,6 +35,7 @@
 #include <QMessageBox>
 #include <QDialogButtonBox>
 #include <QTimer>
+#include <QElapsedTimer>
 #include <QRadioButton>
 #include <QColorDialog>
 #include <QObject>
@@ -51,6 +52,7 @@
 #include "historydisplay.h"
 #include "polarplane.h"
 #include "port.h"
+#include "framegovernor.h"
 #include "geomath.h"
 #include "tiltplane.h"
 
@@ -518,6 +520,9 @@ public:
     ProgressBar *displayProgressBar;
     ProgressBar *exportProgressBar;
     
+    // how many terms the preview left out as finer than a pixel
+    QLabel *skippedTermsLabel;
+    
     // OUTPUT IMAGE DIM POP UP
     QWidget *imageDimensionsPopUp;
     QVBoxLayout *imageDimensionsPopUpLayout;
@@ -591,11 +596,17 @@ signals:
     void popUpImageExportFinished(const QString &filePath);
     
     void resetMainWindowButton(const bool &status);
+    void recordPreviewFrame();
+    void settlePreview();
     
     void showFunctionIcons() { functionIconsWindow->hide(), functionIconsWindow->show(); }
     void showOverflowColorPopUp() { setOverflowColorPopUp->show(); }
     
     void addNewImageDataPoint(const ComplexValue &data) { *imageDataSeries << QPointF(data.real(), data.imag()); }
+    void updateSkippedTerms(int count) {
+        skippedTermsLabel->setText(tr("%n term(s) finer than a pixel left out of the preview", 0, count));
+        skippedTermsLabel->setVisible(count > 0);
+    }
     void showImageDataGraph() { updateImageDataGraph(); imageDataWindow->hide(); imageDataWindow->show(); }
     void updateImageDataGraph();
     
@@ -630,6 +641,7 @@ private:
     void removeTableTerm(int row);
     void refreshLabels();
     void updatePreviewDisplay();
+    void renderPreview(int finestStep);
     void errorHandler(const int &flag);
     void refreshTableTerms();
     void refreshMainWindowTerms();
@@ -662,6 +674,15 @@ private:
     bool widthChanged;
     bool errPrint;
     
+    //interactive preview timing (see updatePreviewDisplay)
+    FrameGovernor frameGovernor;
+    QElapsedTimer previewClock;
+    QTimer *previewSettleTimer;
+    qint64 lastPreviewRequest;      //ms on previewClock, -1 before the first one
+    qint64 previewStarted;
+    int previewStep;                //finest pass of the frame last asked for
+    bool previewInFlight;
+    
     //I/O-related variables    
     QString saveloadPath;
     QString currFileName;
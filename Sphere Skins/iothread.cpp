@@ -11,7 +11,7 @@ IOThread::~IOThread()
 }
 
 
-void IOThread::prepareToWrite(QImage *output, const QString &filePathToExport)
+void IOThread::prepareToWrite(const QImage &output, const QString &filePathToExport)
 {
     
     QMutexLocker locker(&mutex);
@@ -26,7 +26,7 @@ void IOThread::prepareToWrite(QImage *output, const QString &filePathToExport)
 void IOThread::run()
 {
     
-    output->save(filePathToExport);
+    output.save(filePathToExport);
     QDir stickypath(filePathToExport);
     stickypath.cdUp();
     result = stickypath.path();
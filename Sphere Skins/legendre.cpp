@@ -0,0 +1,71 @@
+#include "legendre.h"
+
+#include <cmath>
+
+#include <QtGlobal>
+
+// P_m^m(x) = (2m-1)!! s^m with s = sqrt(1 - x^2)
+static double diagonal(int m, double x)
+{
+    double s = std::sqrt(qMax(0.0, 1.0 - x * x));
+    double value = 1.0;
+    for (int k = 1; k <= m; k++)
+        value *= (2 * k - 1) * s;
+    return value;
+}
+
+double associatedLegendre(int l, int m, double x)
+{
+    if (m < 0 || m > l) return 0.0;
+
+    double previous = 0.0, current = diagonal(m, x);
+    for (int k = m + 1; k <= l; k++)
+    {
+        double next = ((2 * k - 1) * x * current - (k + m - 1) * previous) / (k - m);
+        previous = current;
+        current = next;
+    }
+    return current;
+}
+
+LegendreTable::LegendreTable(double x, int degree) : values((degree + 1) * (degree + 2) / 2)
+{
+    for (int m = 0; m <= degree; m++)
+    {
+        double previous = 0.0, current = diagonal(m, x);
+        values[m * (m + 1) / 2 + m] = current;
+        for (int l = m + 1; l <= degree; l++)
+        {
+            double next = ((2 * l - 1) * x * current - (l + m - 1) * previous) / (l - m);
+            previous = current;
+            current = next;
+            values[l * (l + 1) / 2 + m] = current;
+        }
+    }
+}
+
+// Newton's method on P_n from the usual cosine guesses; the derivative
+// comes from P_n' = n (x P_n - P_(n-1)) / (x^2 - 1)
+void gaussLegendre(int n, double *nodes, double *weights)
+{
+    const double PI = 3.14159265358979323846;
+
+    for (int i = 0; i < n; i++)
+    {
+        double x = std::cos(PI * (i + 0.75) / (n + 0.5));
+        double derivative = 1.0;
+        for (int iteration = 0; iteration < 100; iteration++)
+        {
+            double pn = associatedLegendre(n, 0, x);
+            double pn1 = associatedLegendre(n - 1, 0, x);
+            derivative = n * (x * pn - pn1) / (x * x - 1.0);
+
+            double step = pn / derivative;
+            x -= step;
+            if (std::abs(step) < 1e-15) break;
+        }
+
+        nodes[i] = x;
+        weights[i] = 2.0 / ((1.0 - x * x) * derivative * derivative);
+    }
+}
@@ -0,0 +1,35 @@
+#ifndef LEGENDRE_H
+#define LEGENDRE_H
+
+#include <QVarLengthArray>
+
+// Associated Legendre functions P_l^m(x) for |x| <= 1, unnormalised and
+// without the Condon-Shortley phase, as Leg() (geomath.h) has always used
+// them. Every order is started from its diagonal and carried up in degree
+// by the three-term recurrence, which is the stable direction:
+//     P_m^m     = (2m-1)!! (1-x^2)^(m/2)
+//     P_(m+1)^m = (2m+1) x P_m^m
+//     (l-m) P_l^m = (2l-1) x P_(l-1)^m - (l+m-1) P_(l-2)^m
+// Unnormalised, the values grow like (2l)!/l!, so degrees past about 150
+// overflow a double.
+
+// a single P_l^m(x), in O(l) steps; 0 outside 0 <= m <= l
+double associatedLegendre(int l, int m, double x);
+
+// all P_l^m(x) for 0 <= m <= l <= degree at one x, in O(degree^2) steps
+class LegendreTable
+{
+public:
+    LegendreTable(double x, int degree);
+
+    double operator()(int l, int m) const { return values[l * (l + 1) / 2 + m]; }
+
+private:
+    QVarLengthArray<double, 256> values;
+};
+
+// the n-point Gauss-Legendre rule on [-1, 1], exact for polynomials of
+// degree below 2n
+void gaussLegendre(int n, double *nodes, double *weights);
+
+#endif // LEGENDRE_H
@@ -36,7 +36,7 @@ public:
     // CONST-MEMBER FUNCTIONS
     double R() const {return r;}
     double A() const {return a;}
-    std::complex<double> combined()
+    std::complex<double> combined() const
     {
         std::complex<double> ans = ei(a);
         return ans * r;
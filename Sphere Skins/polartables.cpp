@@ -0,0 +1,180 @@
+#include "polartables.h"
+#include "fft.h"
+#include "legendre.h"
+
+#include <cmath>
+
+// one angular frequency with its weighted coefficient and radial factor:
+// r^exponent for a power term's direct part or, for inv/neginv, its
+// reciprocal; P_degree^|frequency|(zee) for a harmonic (degree >= 0)
+struct PolarPart
+{
+    std::complex<double> coeff;
+    int frequency;
+    int exponent;
+    int degree;
+};
+
+static QVector<PolarPart> polarParts(const FunctionPlan &plan)
+{
+    QVector<PolarPart> table;
+    if (plan.harmonic) {
+        for (int k = 0; k < plan.harmonics.size(); k++)
+        {
+            const PlanTerm &harmonic = plan.harmonics[k];
+            PolarPart part = { harmonic.coeff, harmonic.m, 0, harmonic.n };
+            table.push_back(part);
+        }
+        return table;
+    }
+
+    for (int k = 0; k < plan.terms.size(); k++)
+    {
+        const PlanTerm &term = plan.terms[k];
+        PolarPart part = { term.coeff * plan.direct, term.n - term.m, term.n + term.m, -1 };
+        table.push_back(part);
+
+        if (plan.reciprocal != 0.0) {
+            PolarPart inverse = { term.coeff * plan.reciprocal, term.m - term.n, -(term.n + term.m), -1 };
+            table.push_back(inverse);
+        }
+    }
+    return table;
+}
+
+// every part's radial factor on the row of stereographic radius r. A row
+// past either pole has r < 0, which is the radius |r| half a turn round;
+// the powers r^exponent carry that sign themselves, the harmonics need it
+// as (-1)^frequency
+static void radialFactors(const FunctionPlan &plan, const QVector<PolarPart> &table, double r, double *factors)
+{
+    if (!plan.harmonic) {
+        for (int j = 0; j < table.size(); j++)
+            factors[j] = std::pow(r, table[j].exponent);
+        return;
+    }
+
+    LegendreTable legendre((1.0 - r * r) / (1.0 + r * r), plan.harmonicDegree);
+    for (int j = 0; j < table.size(); j++)
+    {
+        int order = qAbs(table[j].frequency);
+        factors[j] = legendre(table[j].degree, order);
+        if (r < 0.0 && order % 2 != 0)
+            factors[j] = -factors[j];
+    }
+}
+
+void PolarTables::build(const FunctionPlan &plan, const double *thetas, int columns, const double *radii, int rows)
+{
+    QVector<PolarPart> table = polarParts(plan);
+
+    this->parts = table.size();
+    this->columns = columns;
+    this->rows = rows;
+
+    columnRe.resize(columns * parts);
+    columnIm.resize(columns * parts);
+    for (int c = 0; c < columns; c++)
+    {
+        for (int j = 0; j < parts; j++)
+        {
+            double t = table[j].frequency * thetas[c];
+            double cs = std::cos(t), sn = std::sin(t);
+            columnRe[c * parts + j] = table[j].coeff.real() * cs - table[j].coeff.imag() * sn;
+            columnIm[c * parts + j] = table[j].coeff.real() * sn + table[j].coeff.imag() * cs;
+        }
+    }
+
+    rowRadial.resize(parts * rows);
+    QVector<double> factors(parts);
+    for (int r = 0; r < rows; r++)
+    {
+        radialFactors(plan, table, radii[r], factors.data());
+        for (int j = 0; j < parts; j++)
+            rowRadial[j * rows + r] = factors[j];
+    }
+}
+
+void PolarTables::evaluateColumn(int column, int firstRow, int count, double *re, double *im) const
+{
+    for (int r = 0; r < count; r++)
+    {
+        re[r] = 0.0;
+        im[r] = 0.0;
+    }
+
+    const double *cRe = columnRe.constData() + column * parts;
+    const double *cIm = columnIm.constData() + column * parts;
+    for (int j = 0; j < parts; j++)
+    {
+        const double a = cRe[j], b = cIm[j];
+        const double *radial = rowRadial.constData() + j * rows + firstRow;
+
+        for (int r = 0; r < count; r++)
+        {
+            re[r] += a * radial[r];
+            im[r] += b * radial[r];
+        }
+    }
+}
+
+static const int SYNTHESIS_BLOCK_ROWS = 32;
+
+void LongitudeSynthesis::build(const FunctionPlan &plan, int turn, double theta0, int firstColumn, int columns, const double *radii, int rows)
+{
+    QVector<PolarPart> table = polarParts(plan);
+    this->columns = columns;
+    this->rows = rows;
+
+    // the rotation by theta0 goes into the coefficients, and frequencies
+    // wrap around into the transform's bins
+    QVector<std::complex<double> > shifted(table.size());
+    QVector<int> bins(table.size());
+    for (int j = 0; j < table.size(); j++)
+    {
+        shifted[j] = table[j].coeff * std::polar(1.0, table[j].frequency * theta0);
+        bins[j] = ((table[j].frequency % turn) + turn) % turn;
+    }
+
+    fieldRe.resize(columns * rows);
+    fieldIm.resize(columns * rows);
+
+    // a block of rows at a time, so the transforms share their roots of unity
+    QVector<std::complex<double> > block(SYNTHESIS_BLOCK_ROWS * turn);
+    QVector<double> factors(table.size());
+    for (int first = 0; first < rows; first += SYNTHESIS_BLOCK_ROWS)
+    {
+        int count = qMin(SYNTHESIS_BLOCK_ROWS, rows - first);
+        block.fill(0.0);
+        for (int b = 0; b < count; b++)
+        {
+            std::complex<double> *row = block.data() + b * turn;
+            radialFactors(plan, table, radii[first + b], factors.data());
+            for (int j = 0; j < table.size(); j++)
+                row[bins[j]] += shifted[j] * factors[j];
+        }
+
+        fftRows(block, count, turn, +1);
+
+        for (int b = 0; b < count; b++)
+        {
+            const std::complex<double> *row = block.constData() + b * turn;
+            for (int c = 0; c < columns; c++)
+            {
+                fieldRe[c * rows + first + b] = row[firstColumn + c].real();
+                fieldIm[c * rows + first + b] = row[firstColumn + c].imag();
+            }
+        }
+    }
+}
+
+void LongitudeSynthesis::evaluateColumn(int column, double *re, double *im) const
+{
+    const double *cRe = fieldRe.constData() + column * rows;
+    const double *cIm = fieldIm.constData() + column * rows;
+    for (int r = 0; r < rows; r++)
+    {
+        re[r] = cRe[r];
+        im[r] = cIm[r];
+    }
+}
@@ -0,0 +1,51 @@
+#ifndef POLARTABLES_H
+#define POLARTABLES_H
+
+#include "functions.h"
+
+// On a grid of constant-longitude columns (angles thetas[c]) and
+// constant-latitude rows (stereographic radii radii[r]), each term of a
+// polar plan factors as
+//     coeff * r^(n+m) e^(i(n-m)theta) = (coeff * e^(i(n-m)theta)) * r^(n+m)
+// and likewise for its reciprocal part, so one complex table over the
+// columns and one real table over the rows per term are enough to sum the
+// whole grid with multiply-adds. The tables take O(columns + rows) sin/cos
+// and pow calls per term instead of O(columns * rows).
+class PolarTables
+{
+public:
+    PolarTables() : parts(0), columns(0), rows(0) { }
+
+    void build(const FunctionPlan &plan, const double *thetas, int columns, const double *radii, int rows);
+    // rows firstRow .. firstRow+count-1 of the column
+    void evaluateColumn(int column, int firstRow, int count, double *re, double *im) const;
+    bool isEmpty() const { return columns == 0 || rows == 0; }
+
+private:
+    int parts, columns, rows;
+    QVector<double> columnRe, columnIm;     // [column * parts + j], coefficient folded in
+    QVector<double> rowRadial;              // [j * rows + row]
+};
+
+// When the columns are the samples x = 0 .. turn-1 of one full turn of
+// longitude, theta = theta0 + 2 pi x / turn, each row of a polar plan is a
+// trigonometric polynomial sampled at every point of its period: its
+// Fourier coefficients come straight off the term list, and one inverse FFT
+// of length turn synthesizes the whole row, whatever the number of terms.
+// Only the columns firstColumn .. firstColumn+columns-1 are kept. turn
+// should be smooth (see smoothLength()) for the FFT to be fast.
+class LongitudeSynthesis
+{
+public:
+    LongitudeSynthesis() : columns(0), rows(0) { }
+
+    void build(const FunctionPlan &plan, int turn, double theta0, int firstColumn, int columns, const double *radii, int rows);
+    void evaluateColumn(int column, double *re, double *im) const;
+    bool isEmpty() const { return columns == 0 || rows == 0; }
+
+private:
+    int columns, rows;
+    QVector<double> fieldRe, fieldIm;       // [column * rows + row]
+};
+
+#endif // POLARTABLES_H
@@ -0,0 +1,117 @@
+#include "polyhedral.h"
+#include "geomath.h"
+
+std::complex<double> Mobius::operator()(const std::complex<double> &z) const
+{
+    std::complex<double> denominator = c * z + d;
+
+    // rho3 sends its pole to 1000 rather than to infinity; keep doing so
+    if (denominator == 0.0)
+        return 1000.0;
+
+    return (a * z + b) / denominator;
+}
+
+void Mobius::apply(const std::complex<double> &z, std::complex<double> &p, std::complex<double> &q) const
+{
+    p = a * z + b;
+    q = c * z + d;
+}
+
+Mobius Mobius::operator*(const Mobius &other) const
+{
+    Mobius product;
+    product.a = a * other.a + b * other.c;
+    product.b = a * other.b + b * other.d;
+    product.c = c * other.a + d * other.c;
+    product.d = c * other.b + d * other.d;
+    return product;
+}
+
+static QVector<Mobius> orbitMaps(int threeFold, int fiveFold)
+{
+    const Mobius identity = { 1.0, 0.0, 0.0, 1.0 };
+    const Mobius r3 = { 1.0, Eye, 1.0, -Eye };      // rho3
+    const Mobius r5 = { a5, b5, q5, a5 };           // rho5
+
+    QVector<Mobius> maps;
+    Mobius m5 = identity;
+    for (int k = 0; k < fiveFold; k++)
+    {
+        Mobius m = m5;
+        for (int j = 0; j < threeFold; j++)
+        {
+            maps.push_back(m);
+            m = r3 * m;
+        }
+        m5 = r5 * m5;
+    }
+
+    return maps;
+}
+
+const QVector<Mobius> &tetrahedralOrbit()
+{
+    static const QVector<Mobius> maps = orbitMaps(3, 1);
+    return maps;
+}
+
+const QVector<Mobius> &icosahedralOrbit()
+{
+    static const QVector<Mobius> maps = orbitMaps(3, 5);
+    return maps;
+}
+
+const QVector<Mobius> &fiveFoldOrbit()
+{
+    static const QVector<Mobius> maps = orbitMaps(1, 5);
+    return maps;
+}
+
+void tetrahedralQuotient(const std::complex<double> &p, const std::complex<double> &q, std::complex<double> &num, std::complex<double> &den)
+{
+    std::complex<double> p2 = p * p, q2 = q * q;
+    std::complex<double> quartic = p2 * p2 + q2 * q2;
+    std::complex<double> mixed = Eye * 2.0 * q3 * p2 * q2;
+    num = quartic - mixed;
+    den = quartic + mixed;
+}
+
+OrbitLadders::OrbitLadders(const std::complex<double> &z, const QVector<Mobius> &maps, int reach)
+    : count(maps.size()), reach(reach), width(2 * reach + 1), powers(maps.size() * (2 * reach + 1)), zero(maps.size())
+{
+    for (int p = 0; p < count; p++)
+    {
+        std::complex<double> w = maps[p](z);
+        zero[p] = (w == 0.0);
+        if (zero[p]) continue;
+
+        std::complex<double> *row = powers.data() + p * width + reach;
+        std::complex<double> inverse = 1.0 / w;
+        row[0] = 1.0;
+        for (int q = 1; q <= reach; q++)
+        {
+            row[q] = row[q - 1] * w;
+            row[-q] = row[-q + 1] * inverse;
+        }
+    }
+}
+
+std::complex<double> OrbitLadders::ave2Mean(int N, int M) const
+{
+    std::complex<double> sum(0.0, 0.0);
+    for (int p = 0; p < count; p++)
+    {
+        if (zero[p]) {
+            sum += 10000.0;     // as in ave2
+            continue;
+        }
+
+        const std::complex<double> *row = powers.constData() + p * width + reach;
+        std::complex<double> power = row[N] * conj(row[M]);
+        std::complex<double> inverse = row[-N] * conj(row[-M]);
+        sum += (power + inverse) / 2.0;
+    }
+
+    return sum / double(count);
+}
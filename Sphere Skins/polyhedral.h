@@ -0,0 +1,49 @@
+#ifndef POLYHEDRAL_H
+#define POLYHEDRAL_H
+
+#include <complex>
+
+#include <QVector>
+#include <QVarLengthArray>
+
+// the Moebius transformation z -> (a z + b) / (c z + d)
+struct Mobius
+{
+    std::complex<double> a, b, c, d;
+
+    std::complex<double> operator()(const std::complex<double> &z) const;
+    void apply(const std::complex<double> &z, std::complex<double> &p, std::complex<double> &q) const;    // image p/q, poles included
+    Mobius operator*(const Mobius &other) const;    // this after other
+};
+
+// The maps ave3 and ave5 (geomath.h) average ave2 over, precomputed as
+// matrices: rho3^j for j < 3, and rho3^j o rho5^k for j < 3, k < 5. icos3
+// only averages over the five-fold part, rho5^k for k < 5.
+const QVector<Mobius> &tetrahedralOrbit();
+const QVector<Mobius> &icosahedralOrbit();
+const QVector<Mobius> &fiveFoldOrbit();
+
+// The quotient (z^4 + 1 - 2 sqrt3 i z^2) / (z^4 + 1 + 2 sqrt3 i z^2) that
+// tetra3, tetraCol and icos3 are built from, taken at z = p/q as the pair
+// of homogeneous quartics so that q = 0 needs no special case.
+void tetrahedralQuotient(const std::complex<double> &p, const std::complex<double> &q, std::complex<double> &num, std::complex<double> &den);
+
+// The images of one point under an orbit's maps, each with its integer
+// powers -reach..reach, so that every term evaluated at a pixel shares the
+// same Moebius applications and power ladders. ave2Mean(N, M) is then
+//     (1/count) * sum over the images w of ave2(w, N, M)
+// which is ave3 or ave5 of the original point without a single pow().
+class OrbitLadders
+{
+public:
+    OrbitLadders(const std::complex<double> &z, const QVector<Mobius> &maps, int reach);
+
+    std::complex<double> ave2Mean(int N, int M) const;
+
+private:
+    int count, reach, width;
+    QVarLengthArray<std::complex<double>, 512> powers;    // [p * width + reach + q] = w_p^q
+    QVarLengthArray<bool, 16> zero;
+};
+
+#endif // POLYHEDRAL_H
@@ -9,30 +9,36 @@ Port::Port(AbstractFunction *currFunction, ColorWheel *currColorWheel, int width
     this->currColorWheel = currColorWheel;
     this->currSettings = currSettings;
     
-    output = new QImage();
     display = new Display();
     
-    controllerObject = new Controller(display, output);
+    controllerObject = new Controller();
     controller = new ControllerThread(this->currFunction, this->currColorWheel, this->currSettings, controllerObject, QSize(overallWidth, overallHeight), this);
     
     controllerObject->moveToThread(controller);
     connect(controllerObject, SIGNAL(workFinished(int)), this, SLOT(handleRenderedImage(int)));
+    connect(controllerObject, SIGNAL(tileReady(QRect)), this, SLOT(handleFinishedTile(QRect)));
     
 }
 
 
-void Port::exportImage(QImage *output, const QString &fileName)
+// the export is rendered straight into a frame of its size, which the
+// IOThread then saves as it is
+void Port::exportImage(const QString &fileName)
 {
+    output = QSharedPointer<RenderTarget>(new RenderTarget(currSettings->OWidth, currSettings->OHeight));
+    if (output->isNull())
+        return;
+    
     filePathToExport = fileName;
-    this->output = output;
     render(output, IMAGE_EXPORT_FLAG);
 }
 
 
-void Port::paintToDisplay(Display *display)
+// a finestStep over 1 draws the preview only down to that coarse pass
+void Port::paintToDisplay(Display *display, int finestStep)
 {
     this->display = display;
-    render(display, DISPLAY_REPAINT_FLAG);
+    render(display, DISPLAY_REPAINT_FLAG, finestStep);
 }
 
 
@@ -47,28 +53,27 @@ void Port::handleRenderedImage(const int &actionFlag)
     QString result = "";
     switch (actionFlag) {
         case DISPLAY_REPAINT_FLAG:
-            display->repaint();
-            break;
         case HISTORY_ICON_REPAINT_FLAG:
-            display->repaint();
+            // every tile was repainted as it came in
             break;
         case IMAGE_EXPORT_FLAG:
             IOThread *ioThread = new IOThread();
             connect(ioThread, SIGNAL(finishedExport(QString)), this, SLOT(handleFinishedExport(QString)));
-            ioThread->prepareToWrite(output, filePathToExport);
+            ioThread->prepareToWrite(output->image(), filePathToExport);
+            output.clear();
             break;
     }
     emit paintingFinished(true);
     
 }
 
-void Port::render(QImage *output, const int &actionFlag)
+void Port::render(const QSharedPointer<RenderTarget> &output, const int &actionFlag)
 {
     controller->prepareToRun(output, actionFlag);
 }
 
-void Port::render(Display *display, const int &actionFlag)
+void Port::render(Display *display, const int &actionFlag, int finestStep)
 {
-    controller->prepareToRun(display, actionFlag);
+    controller->prepareToRun(display, actionFlag, finestStep);
 }
 
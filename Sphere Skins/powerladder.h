@@ -0,0 +1,71 @@
+#ifndef POWERLADDER_H
+#define POWERLADDER_H
+
+#include <complex>
+#include <limits>
+
+#include <QVarLengthArray>
+
+// The integer powers z^lo .. z^hi (lo <= 0 <= hi) of one complex number,
+// built by repeated multiplication out from z^0 = 1 so that all the terms
+// evaluated at a pixel can share them instead of calling pow() each.
+// Negative powers are powers of 1/z, which is computed once.
+class PowerLadder
+{
+public:
+    PowerLadder(const std::complex<double> &z, int lo, int hi) : powers(hi - lo + 1)
+    {
+        zero = powers.data() - lo;
+        fill(z, lo, hi);
+    }
+    
+    // Powers of the quotient num/den, exact where either side vanishes: at
+    // a pole (den = 0) the negative powers are 0 and the positive ones are
+    // infinite, and the other way round at a zero, rather than whatever
+    // dividing by zero first would leave.
+    PowerLadder(const std::complex<double> &num, const std::complex<double> &den, int lo, int hi) : powers(hi - lo + 1)
+    {
+        zero = powers.data() - lo;
+        
+        // neither vanishes, or both do and 0/0 is as undefined as ever
+        if ((num == 0.0) == (den == 0.0)) {
+            fill(num / den, lo, hi);
+            return;
+        }
+        
+        const double infinity = std::numeric_limits<double>::infinity();
+        double positive = (den == 0.0) ? infinity : 0.0;
+        double negative = (den == 0.0) ? 0.0 : infinity;
+        
+        zero[0] = 1.0;
+        for (int p = 1; p <= hi; p++)
+            zero[p] = positive;
+        for (int p = -1; p >= lo; p--)
+            zero[p] = negative;
+    }
+    
+    const std::complex<double> &operator[](int p) const { return zero[p]; }
+    
+private:
+    void fill(const std::complex<double> &z, int lo, int hi)
+    {
+        zero[0] = 1.0;
+        
+        for (int p = 1; p <= hi; p++)
+            zero[p] = zero[p - 1] * z;
+        
+        if (lo < 0) {
+            std::complex<double> inverse = 1.0 / z;
+            for (int p = -1; p >= lo; p--)
+                zero[p] = zero[p + 1] * inverse;
+        }
+    }
+    
+    PowerLadder(const PowerLadder &);
+    PowerLadder &operator=(const PowerLadder &);
+    
+    QVarLengthArray<std::complex<double>, 64> powers;
+    std::complex<double> *zero;
+};
+
+#endif // POWERLADDER_H
@@ -0,0 +1,45 @@
+#include "rendertarget.h"
+
+#include <QDebug>
+#include <QtGlobal>
+
+RenderTarget::RenderTarget(int width, int height)
+    : pixels(0), columns(0), rows(0), stride(0)
+{
+    if (width <= 0 || height <= 0)
+        return;
+
+    int lineAlignment = RENDER_TARGET_ALIGNMENT / sizeof(QRgb);
+    int alignedWidth = (width + lineAlignment - 1) / lineAlignment * lineAlignment;
+    size_t bytes = size_t(alignedWidth) * sizeof(QRgb) * height;
+
+    void *buffer = qMallocAligned(bytes, RENDER_TARGET_ALIGNMENT);
+    if (!buffer) {
+        qDebug() << "RenderTarget: cannot allocate a" << width << "x" << height << "frame";
+        return;
+    }
+
+    // the image owns the buffer from here on
+    frame = QImage(static_cast<uchar *>(buffer), width, height, alignedWidth * sizeof(QRgb),
+                   QImage::Format_RGB32, qFreeAligned, buffer);
+
+    pixels = static_cast<QRgb *>(buffer);
+    columns = width;
+    rows = height;
+    stride = alignedWidth;
+}
+
+void RenderTarget::fill(QRgb color)
+{
+    for (int y = 0; y < rows; y++)
+    {
+        QRgb *line = pixels + ptrdiff_t(y) * stride;
+        for (int x = 0; x < columns; x++)
+            line[x] = color;
+    }
+}
+
+TileView RenderTarget::view(const QRect &rect) const
+{
+    return TileView(pixels + ptrdiff_t(rect.y()) * stride + rect.x(), stride, rect.width(), rect.height());
+}
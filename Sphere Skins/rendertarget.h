@@ -0,0 +1,63 @@
+#ifndef RENDERTARGET_H
+#define RENDERTARGET_H
+
+#include <cstddef>
+
+#include <QImage>
+#include <QRect>
+
+// bytes every row of a RenderTarget starts on a multiple of
+const int RENDER_TARGET_ALIGNMENT = 64;
+
+// one tile's window into a RenderTarget. The render threads write the
+// views of their tiles at the same time; the tiles are disjoint, so no
+// pixel is written twice
+class TileView
+{
+public:
+    TileView() : origin(0), stride(0), columns(0), rows(0) { }
+    TileView(QRgb *origin, int stride, int columns, int rows)
+        : origin(origin), stride(stride), columns(columns), rows(rows) { }
+
+    int width() const { return columns; }
+    int height() const { return rows; }
+
+    QRgb pixel(int x, int y) const { return origin[ptrdiff_t(y) * stride + x]; }
+    void setPixel(int x, int y, QRgb color) const { origin[ptrdiff_t(y) * stride + x] = color; }
+
+private:
+    QRgb *origin;
+    int stride;             // pixels from one row to the next
+    int columns, rows;
+};
+
+// The frame a render writes into: a single row-major RGB32 buffer, sized
+// once up front, whose rows start on cache-line boundaries. Each render
+// thread writes its tiles straight into it through view(), so the only
+// thing to cross threads when a tile is done is its rectangle.
+//
+// image() wraps the buffer without copying it, and the buffer is freed
+// with the last QImage sharing it, so an export can be saved after its
+// target is gone. If the buffer cannot be allocated the target is null.
+class RenderTarget
+{
+public:
+    RenderTarget() : pixels(0), columns(0), rows(0), stride(0) { }
+    RenderTarget(int width, int height);
+
+    bool isNull() const { return pixels == 0; }
+    int width() const { return columns; }
+    int height() const { return rows; }
+
+    void fill(QRgb color);
+    TileView view(const QRect &rect) const;
+    const QImage &image() const { return frame; }
+
+private:
+    QImage frame;
+    QRgb *pixels;
+    int columns, rows;
+    int stride;
+};
+
+#endif // RENDERTARGET_H
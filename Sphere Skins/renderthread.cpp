@@ -1,9 +1,17 @@
 #include "renderthread.h"
+#include "fft.h"
 
 RenderThread::RenderThread(AbstractFunction *function, ColorWheel *colorwheel, Settings *settings, QSize outputSize, QObject *parent) : QThread(parent)
 {
     restart = false;
-    abort = false;
+    abort.storeRelease(0);
+    scheduler = 0;
+    worker = 0;
+    frame = 0;
+    working = 0;
+    step = 1;
+    lastPass = true;
+    actionFlag = IMAGE_EXPORT_FLAG;
     
     currFunction = function;
     currColorWheel = colorwheel;
@@ -18,25 +26,26 @@ RenderThread::RenderThread(AbstractFunction *function, ColorWheel *colorwheel, S
 RenderThread::~RenderThread()
 {
     mutex.lock();
-    abort = true;
+    abort.storeRelease(1);
     condition.wakeOne();
     mutex.unlock();
     
     wait();
 }
 
-void RenderThread::render(QPoint topLeft, QPoint bottomRight, QWaitCondition *controllerCondition)
+void RenderThread::render(TileScheduler *scheduler, int frame, int worker, const QSharedPointer<RenderTarget> &target,
+                          const QSharedPointer<FrameEvaluation> &evaluation, int step, bool lastPass,
+                          QWaitCondition *controllerCondition)
 {
     QMutexLocker locker(&mutex);
     
-    this->topLeft = topLeft;
-    this->bottomRight = bottomRight;
-    topLeftXValue = topLeft.x();
-    topLeftYValue = topLeft.y();
-    
-    bottomRightXValue = bottomRight.x();
-    bottomRightYValue = bottomRight.y();
-    
+    this->scheduler = scheduler;
+    this->worker = worker;
+    this->target = target;
+    this->evaluation = evaluation;
+    this->step = step;
+    this->lastPass = lastPass;
+    this->frame = frame;
     this->controllerCondition = controllerCondition;
     worldYStart1 = currSettings->Height + currSettings->YCorner;
     worldYStart2 = currSettings->Height/overallHeight;
@@ -51,73 +60,347 @@ void RenderThread::render(QPoint topLeft, QPoint bottomRight, QWaitCondition *co
 }
 
 
-void RenderThread::run()
+void FrameField::prepare(const AbstractFunction *function, const FunctionPlan &plan, const Settings &settings,
+                         const QSharedPointer<CoordinateGrid> &grid)
 {
-    forever {
-        mutex.lock();
-        
-        double worldX, worldY;
-        double worldYStart1 = this->worldYStart1;
-        double worldYStart2 = this->worldYStart2;
-        double worldXStart = this->worldXStart;
-        double XCorner = currSettings->XCorner;
-        std::complex<double> zStereo;
+    this->function = function;
+    this->plan = plan;
+    this->grid = grid;
+    xCorner = settings.XCorner;
+    
+    // zzbar, inv and neginv split into a factor per longitude column and
+    // one per latitude row (stereographic radius). If the whole image is
+    // one turn of longitude, each row is synthesized by an inverse FFT;
+    // otherwise both factors are tabulated up front
+    if (plan.polar) {
+        fullTurn = qAbs(settings.Width - 2.0 * M_PI) <= FULL_TURN_TOLERANCE && smoothLength(grid->columns()) == grid->columns();
+        if (!fullTurn)
+            polarTables.build(plan, grid->longitudes(), grid->columns(), grid->radii(), grid->rows());
+    }
+}
+
+FieldEvaluator::FieldEvaluator(const FrameField &field, int firstColumn, int firstRow, int columns, int rows)
+    : field(&field), firstColumn(firstColumn), firstRow(firstRow), columns(columns), rows(rows)
+{
+    if (field.plan.polar && field.fullTurn)
+        rowSynthesis.build(field.plan, field.grid->columns(), field.xCorner, firstColumn, columns, field.grid->radii() + firstRow, rows);
+}
+
+void FieldEvaluator::evaluateColumn(int column, double *re, double *im)
+{
+    if (!rowSynthesis.isEmpty()) {
+        rowSynthesis.evaluateColumn(column, re, im);
+    } else if (!field->polarTables.isEmpty()) {
+        field->polarTables.evaluateColumn(column + firstColumn, firstRow, rows, re, im);
+    } else {
+        // the column's points, gathered from the separable grid
+        pointX.resize(rows);
+        pointY.resize(rows);
+        field->grid->points(column + firstColumn, firstRow, 1, rows, pointX.data(), pointY.data());
+        field->function->evaluateBatch(field->plan, pointX.constData(), pointY.constData(), rows, re, im);
+    }
+}
+
+void FieldEvaluator::evaluateRows(int column, int firstRow, int rowStep, double *re, double *im)
+{
+    int count = (rows - firstRow + rowStep - 1) / rowStep;
+    if (count <= 0)
+        return;
+    
+    pointX.resize(count);
+    pointY.resize(count);
+    valuesRe.resize(count);
+    valuesIm.resize(count);
+    field->grid->points(column + firstColumn, this->firstRow + firstRow, rowStep, count, pointX.data(), pointY.data());
+    
+    field->function->evaluateBatch(field->plan, pointX.constData(), pointY.constData(), count, valuesRe.data(), valuesIm.data());
+    
+    for (int i = 0; i < count; i++) {
+        re[firstRow + i * rowStep] = valuesRe[i];
+        im[firstRow + i * rowStep] = valuesIm[i];
+    }
+}
+
+FrameEvaluation::FrameEvaluation(const AbstractFunction *function, const Settings &settings, int width, int height, bool draft)
+    : evaluated(function), settings(settings), skippedTerms(0)
+{
+    // previews and history icons leave out terms finer than a pixel
+    termList = function->compileTerms();
+    if (draft)
+        skippedTerms = function->limitDetail(termList, settings.Width / width, settings.Height / height);
+    compiled = function->compile(termList);
+    
+    // the stereographic points of the whole render, shared with the
+    // other renders of the same world rectangle
+    grid = CoordinateGrid::shared(settings, width, height);
+}
+
+const FrameField &FrameEvaluation::field()
+{
+    if (planBuilt.loadAcquire() == 0) {
+        QMutexLocker locker(&lock);
+        if (planBuilt.loadAcquire() == 0) {
+            planField.prepare(evaluated, compiled, settings, grid);
+            planBuilt.storeRelease(1);
+        }
+    }
+    
+    return planField;
+}
+
+const FrameField &FrameEvaluation::termField(int k)
+{
+    if (termsBuilt.loadAcquire() == 0) {
+        QMutexLocker locker(&lock);
+        if (termsBuilt.loadAcquire() == 0) {
+            termFields.resize(termList.terms.size());
+            for (unsigned int j = 0; j < (unsigned int) termFields.size(); j++)
+                termFields[j].prepare(evaluated, evaluated->compileTerm(j), settings, grid);
+            termsBuilt.storeRelease(1);
+        }
+    }
+    
+    return termFields[k];
+}
+
+QSharedPointer<FrameEvaluation> RenderThread::prepareFrame(int width, int height)
+{
+    QMutexLocker locker(&mutex);
+    return QSharedPointer<FrameEvaluation>(new FrameEvaluation(currFunction, *currSettings, width, height,
+                                                               actionFlag != IMAGE_EXPORT_FLAG));
+}
+
+// colors rows 0..rows-1 of the tile's column x from one column of the field
+template <typename Sample>
+void RenderThread::colorColumn(const Sample *re, const Sample *im, int x, int rows, const TileView &view)
+{
+    for (int y = 0; y < rows; y++)
+    {
+        //...then convert that complex output to a color according to our color wheel
+        std::complex<double> fout(re[y], im[y]);
+        QRgb color = (*currColorWheel)(fout);
         
-        double outputWidth = bottomRightXValue - topLeftXValue;
-        double outputHeight = bottomRightYValue - topLeftYValue;
+        if (y % 10 == 0 && x % 10 == 0) {
+            std::complex<double> zDataPoint = currColorWheel->getImagedataPoint();
+            emit newImageDataPoint(zDataPoint);
+        }
         
-        int translated = topLeftXValue;
-        std::complex<double> fout;
-        std::complex<double> zDataPoint;
-        QPoint topLeft = this->topLeft;
-        QVector<QVector<QRgb>> colorMap(outputWidth, QVector<QRgb>(outputHeight));
+        // now, push the determined color to the corresponding point on the display
+        view.setPixel(x, y, color);
+    }
+}
+
+// draws one coarse pass of a preview tile: the pixel at every step-th
+// column and row of it, each filling the step x step block it is the
+// corner of. A pass after the first finds every other corner already
+// drawn by the one before, at twice its step, and keeps it. The samples
+// also go into kept, if given, for the later passes to build on
+void RenderThread::sketchTile(const FrameEvaluation &evaluation, const QRect &rect, int step, const TileView &view, FieldCache *kept)
+{
+    const QSharedPointer<CoordinateGrid> &grid = evaluation.coordinates();
+    bool refining = step < PREVIEW_COARSEST_STEP;
+    int samples = (rect.height() + step - 1) / step;
+    QVector<double> pointX(samples), pointY(samples);
+    QVector<double> fieldRe(samples), fieldIm(samples);
+    
+    for (int x = 0; x < rect.width(); x += step)
+    {
+        if (cancelled()) return;
         
-        mutex.unlock();
+        // the previous pass took every other row of every other column
+        int firstRow = 0, rowStep = step;
+        if (refining && x % (2 * step) == 0) {
+            firstRow = step;
+            rowStep = 2 * step;
+        }
         
+        int count = (rect.height() - firstRow + rowStep - 1) / rowStep;
+        if (count <= 0) continue;
+        grid->points(rect.x() + x, rect.y() + firstRow, rowStep, count, pointX.data(), pointY.data());
         
+        evaluation.function()->evaluateBatch(evaluation.plan(), pointX.constData(), pointY.constData(), count, fieldRe.data(), fieldIm.data());
+        if (kept)
+            kept->storeSamples(x, firstRow, rowStep, count, fieldRe.constData(), fieldIm.constData());
         
-        for (int x = 0; x < outputWidth; x++)
+        int blockWidth = qMin(step, rect.width() - x);
+        for (int i = 0; i < count; i++)
         {
-            if (restart) {
-                break;
-            }
-            if (abort) return;
+            int y = firstRow + i * rowStep;
+            int blockHeight = qMin(step, rect.height() - y);
+            QRgb color = (*currColorWheel)(std::complex<double>(fieldRe[i], fieldIm[i]));
             
-            for (int y = 0; y < outputHeight; y++)
-            {
-                if (restart) break;
-                if (abort) return;
-                
-                worldX = (x + translated) * worldXStart + XCorner;
-                worldY = worldYStart1 - y * worldYStart2;
-                //worldX and worldY should be angles with 0<=X<2pi and 0 <=Y<pi
-                //compute stereographic projection of these angles
-                //...then convert that complex output to a color according to our color wheel
-                zStereo=ei(worldX)*qSin(worldY)/(1-qCos(worldY));
-                fout = (*currFunction)(zStereo.real(),zStereo.imag());
-                QRgb color = (*currColorWheel)(fout);
-                
-                if (y % 10 == 0 && x % 10 == 0) {
-                    zDataPoint = currColorWheel->getImagedataPoint();
-                    emit newImageDataPoint(zDataPoint);
-                }
-                
-                // now, push the determined color to the corresponding point on the display
-                colorMap[x][y] = color;
-            }
+            for (int v = 0; v < blockHeight; v++)
+                for (int u = 0; u < blockWidth; u++)
+                    view.setPixel(x + u, y + v, color);
+        }
+    }
+}
+
+void RenderThread::run()
+{
+    forever {
+        mutex.lock();
+        TileScheduler *scheduler = this->scheduler;
+        int worker = this->worker;
+        int frame = this->frame;
+        QSharedPointer<RenderTarget> target = this->target;
+        QSharedPointer<FrameEvaluation> evaluation = this->evaluation;
+        int step = this->step;
+        bool lastPass = this->lastPass;
+        mutex.unlock();
+        working = frame;
+        
+        // tiles are taken until the frame has none left; the first one also
+        // reports how many terms the frame leaves out
+        int tile;
+        QRect rect;
+        bool first = true;
+        while (scheduler->take(worker, frame, &tile, &rect))
+        {
+            renderTile(tile, rect, *evaluation, step, lastPass, first, target->view(rect));
+            if (abort.loadAcquire()) return;
             
-            if (x % 100 == 0) {
-                emit newProgress((x/outputWidth) * 100);
-            }
+            // a tile of a superseded frame is left unfinished and dropped;
+            // the Controller drops one superseded just after this check
+            if (!cancelled())
+                emit tileFinished(frame, rect);
+            first = false;
         }
+        if (abort.loadAcquire()) return;
+        
         mutex.lock();
         
         if (!restart) {
-            emit renderingFinished(topLeft, colorMap);
-
             condition.wait(&mutex);
         }
         restart = false;
         mutex.unlock();        
     }   
 }
+
+// renders one tile of the frame into its view of the target; returns early
+// once its frame is superseded or on abort, leaving the tile unfinished
+void RenderThread::renderTile(int tile, const QRect &rect, FrameEvaluation &evaluation, int step, bool lastPass, bool reportSkipped,
+                              const TileView &view)
+{
+    mutex.lock();
+    bool caching = actionFlag == DISPLAY_REPAINT_FLAG;
+    mutex.unlock();
+    
+    // the caches belong to the tile, whichever thread takes it
+    TileCaches *caches = caching ? scheduler->caches(tile) : 0;
+    QMutexLocker cacheLocker(caching ? &caches->lock : 0);
+    
+    mutex.lock();
+    
+    int outputWidth = rect.width();
+    int outputHeight = rect.height();
+    
+    int translated = rect.x();
+    int firstRow = rect.y();
+    
+    // the plan, the coordinate grid and the tables are the frame's, built
+    // once and shared read-only by every tile
+    if (reportSkipped)
+        emit termsSkipped(evaluation.skipped());
+    
+    // the preview keeps the field of its last render, so a color-only
+    // change just re-colors it, and while only coefficients change it
+    // re-sums cached basis planes instead of evaluating. The terms alone
+    // are enough for both
+    const FunctionPlan &terms = evaluation.terms();
+    QSharedPointer<CoordinateGrid> grid = evaluation.coordinates();
+    
+    JobKey job(evaluation.function(), terms, grid, translated, firstRow, outputWidth, outputHeight);
+    bool retained = caching && caches->field.holds(job, terms);
+    
+    // a coarse pass leaves out the tiles whose field is kept or can be
+    // re-summed, which are drawn about as fast at full resolution by the
+    // last pass, even when that is a coarse one itself
+    bool sketch = !caching || (!retained && !caches->basis.holds(job));
+    if (step > 1 && (sketch || !lastPass)) {
+        // the preview's field collects the samples pass by pass, from the
+        // first one on, for the full-resolution pass to reuse
+        FieldCache *samples = 0;
+        if (caching && sketch) {
+            if (step == PREVIEW_COARSEST_STEP)
+                caches->field.reset(job, terms);
+            if (step == PREVIEW_COARSEST_STEP || caches->field.holdsSketch(job, terms, 2 * step))
+                samples = &caches->field;
+        }
+        
+        mutex.unlock();
+        if (sketch)
+            sketchTile(evaluation, rect, step, view, samples);
+        if (samples && !cancelled())
+            samples->sketched(step);
+        return;
+    }
+    
+    // when the coarse passes went down to a step of 2, they already took
+    // the even rows of the even columns
+    BasisCache::Lookup lookup = BasisCache::BASIS_MISS;
+    bool corners = false;
+    if (caching && !retained) {
+        lookup = caches->basis.lookup(job);
+        corners = lookup == BasisCache::BASIS_MISS && caches->field.holdsSketch(job, terms, 2);
+        if (!corners)
+            caches->field.reset(job, terms);
+    }
+    
+    // one column of function values at a time
+    QVector<double> fieldRe(outputHeight), fieldIm(outputHeight);
+    
+    mutex.unlock();
+    
+    int planes = lookup == BasisCache::BASIS_BUILD ? terms.terms.size() : 0;
+    for (int k = 0; k < planes && !cancelled(); k++)
+    {
+        FieldEvaluator termEvaluator(evaluation.termField(k), translated, firstRow, outputWidth, outputHeight);
+        for (int x = 0; x < outputWidth; x++)
+        {
+            if (cancelled()) return;
+            termEvaluator.evaluateColumn(x, caches->basis.planeRe(k, x), caches->basis.planeIm(k, x));
+        }
+    }
+    if (lookup == BasisCache::BASIS_BUILD && !cancelled())
+        caches->basis.finishBuilding();
+    
+    bool cached = lookup != BasisCache::BASIS_MISS && caches->basis.isBuilt();
+    if (cached)
+        caches->basis.combine(terms);
+    
+    // the frame's field is left unbuilt while its tiles have no need of it
+    FrameField idle;
+    bool evaluating = !retained && !cached;
+    FieldEvaluator evaluator(evaluating ? evaluation.field() : idle, translated, firstRow, outputWidth, outputHeight);
+    corners = corners && evaluating && evaluator.isPointwise();
+    
+    for (int x = 0; x < outputWidth; x++)
+    {
+        if (cancelled()) return;
+        
+        if (retained) {
+            colorColumn(caches->field.fieldRe(x), caches->field.fieldIm(x), x, outputHeight, view);
+        } else if (cached) {
+            caches->field.store(x, caches->basis.fieldRe(x), caches->basis.fieldIm(x));
+            colorColumn(caches->basis.fieldRe(x), caches->basis.fieldIm(x), x, outputHeight, view);
+        } else {
+            if (corners && x % 2 == 0) {
+                evaluator.evaluateRows(x, 1, 2, fieldRe.data(), fieldIm.data());
+                const FieldSample *keptRe = caches->field.fieldRe(x), *keptIm = caches->field.fieldIm(x);
+                for (int y = 0; y < outputHeight; y += 2) {
+                    fieldRe[y] = keptRe[y];
+                    fieldIm[y] = keptIm[y];
+                }
+            } else {
+                evaluator.evaluateColumn(x, fieldRe.data(), fieldIm.data());
+            }
+            if (caching)
+                caches->field.store(x, fieldRe.constData(), fieldIm.constData());
+            colorColumn(fieldRe.constData(), fieldIm.constData(), x, outputHeight, view);
+        }
+    }
+    if (caching && !retained && !cancelled())
+        caches->field.finish();
+}
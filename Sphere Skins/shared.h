@@ -56,7 +56,7 @@ public:
     
     HistoryItem(QObject *parent = 0) : QObject(parent) { }
     
-    QImage *getImage() { return preview->getImage(); }
+    const QImage &getImage() const { return preview->getImage(); }
     Display *getDisplay() { return preview; }
     
     QVBoxLayout *layoutWithLabelItem;
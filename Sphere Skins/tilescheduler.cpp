@@ -0,0 +1,132 @@
+#include "tilescheduler.h"
+
+#include <QMutexLocker>
+#include <QtAlgorithms>
+
+TileScheduler::~TileScheduler()
+{
+    qDeleteAll(queues);
+    qDeleteAll(tileCaches);
+}
+
+void TileScheduler::setWorkers(int count)
+{
+    QMutexLocker locker(&layoutLock);
+
+    qDeleteAll(queues);
+    queues.clear();
+    for (int i = 0; i < count; i++)
+        queues.push_back(new Queue);
+}
+
+void TileScheduler::setTileSize(const QSize &size)
+{
+    QMutexLocker locker(&layoutLock);
+    this->size = size;
+}
+
+QSize TileScheduler::tileSize() const
+{
+    QMutexLocker locker(&layoutLock);
+    return size;
+}
+
+int TileScheduler::start(int width, int height)
+{
+    QMutexLocker locker(&layoutLock);
+    for (int i = 0; i < queues.size(); i++)
+        queues[i]->lock.lock();
+
+    int frame = generation.fetchAndAddOrdered(1) + 1;
+
+    int tileWidth = size.width() > 0 ? size.width() : width;
+    int tileHeight = size.height() > 0 ? size.height() : height;
+    rects.clear();
+    for (int y = 0; y < height; y += tileHeight)
+        for (int x = 0; x < width; x += tileWidth)
+            rects.push_back(QRect(x, y, qMin(tileWidth, width - x), qMin(tileHeight, height - y)));
+
+    // worker i is dealt tiles [i * n / workers, (i + 1) * n / workers)
+    int tiles = rects.size();
+    int workers = queues.size();
+    for (int i = 0; i < workers; i++)
+    {
+        queues[i]->tiles.clear();
+        for (int k = i * tiles / workers; k < (i + 1) * tiles / workers; k++)
+            queues[i]->tiles.append(k);
+    }
+
+    for (int i = queues.size() - 1; i >= 0; i--)
+        queues[i]->lock.unlock();
+
+    return frame;
+}
+
+int TileScheduler::tileCount() const
+{
+    QMutexLocker locker(&layoutLock);
+    return rects.size();
+}
+
+bool TileScheduler::take(int worker, int frame, int *tile, QRect *rect)
+{
+    Queue *own = queues[worker];
+    {
+        QMutexLocker locker(&own->lock);
+        if (!isCurrent(frame))
+            return false;
+
+        if (!own->tiles.isEmpty()) {
+            *tile = own->tiles.takeFirst();
+            *rect = rects[*tile];
+            return true;
+        }
+    }
+
+    return steal(worker, frame, tile, rect);
+}
+
+// takes the last tile of whichever other queue holds the most; only one
+// queue lock is held at a time, so workers never wait on each other in a
+// cycle
+bool TileScheduler::steal(int worker, int frame, int *tile, QRect *rect)
+{
+    forever {
+        int victim = -1, most = 0;
+        for (int i = 0; i < queues.size(); i++)
+        {
+            if (i == worker) continue;
+
+            QMutexLocker locker(&queues[i]->lock);
+            if (!isCurrent(frame))
+                return false;
+            if (queues[i]->tiles.size() > most) {
+                victim = i;
+                most = queues[i]->tiles.size();
+            }
+        }
+
+        if (victim < 0)
+            return false;
+
+        QMutexLocker locker(&queues[victim]->lock);
+        if (!isCurrent(frame))
+            return false;
+
+        // another worker may have emptied it in the meantime
+        if (!queues[victim]->tiles.isEmpty()) {
+            *tile = queues[victim]->tiles.takeLast();
+            *rect = rects[*tile];
+            return true;
+        }
+    }
+}
+
+TileCaches *TileScheduler::caches(int tile)
+{
+    QMutexLocker locker(&layoutLock);
+    while (tileCaches.size() <= tile)
+        tileCaches.push_back(new TileCaches);
+
+    return tileCaches[tile];
+}
@@ -0,0 +1,86 @@
+#ifndef TILESCHEDULER_H
+#define TILESCHEDULER_H
+
+#include <QAtomicInt>
+#include <QList>
+#include <QMutex>
+#include <QRect>
+#include <QSize>
+#include <QVector>
+
+#include "basiscache.h"
+#include "fieldcache.h"
+
+// what the preview keeps of one tile between renders (see RenderThread).
+// The lock keeps a worker that is still finishing a superseded frame off
+// the caches while another one renders the same tile for the new frame
+struct TileCaches
+{
+    QMutex lock;
+    BasisCache basis;
+    FieldCache field;
+};
+
+// Cuts a render into tiles and hands them out to the render threads. Every
+// worker has a queue of its own, dealt a contiguous run of tiles so that
+// its jobs stay next to each other. It takes tiles off the front of that
+// queue, and once the queue is empty steals off the back of the fullest
+// other one, so a worker that drew cheap tiles helps out with the
+// expensive ones instead of idling until the slowest part is done.
+//
+// Each start() begins a new frame under a new generation number, and
+// cancel() moves the number on without laying out anything. take() only
+// hands out tiles of the generation the worker asks for, so a worker still
+// on a superseded frame never picks up tiles of the next one, and workers
+// poll isCurrent() to drop a superseded tile part way through. The number
+// is atomic, so that poll takes no lock.
+class TileScheduler
+{
+public:
+    TileScheduler() : generation(0) { }
+    ~TileScheduler();
+
+    void setWorkers(int count);
+
+    // tile width and height in pixels, where 0 stands for the whole image
+    // along that axis
+    void setTileSize(const QSize &size);
+    QSize tileSize() const;
+
+    // lays out a width x height frame and returns its generation
+    int start(int width, int height);
+    int tileCount() const;
+
+    // supersedes the frame in flight, if any, without starting another
+    void cancel() { generation.ref(); }
+
+    int currentGeneration() const { return generation.loadAcquire(); }
+    bool isCurrent(int frame) const { return generation.loadAcquire() == frame; }
+
+    // the worker's next tile of the given frame; false once the frame has
+    // no tiles left or has been superseded
+    bool take(int worker, int frame, int *tile, QRect *rect);
+
+    // a tile's caches, made on first use and kept across frames
+    TileCaches *caches(int tile);
+
+private:
+    struct Queue
+    {
+        QMutex lock;
+        QList<int> tiles;
+    };
+
+    bool steal(int worker, int frame, int *tile, QRect *rect);
+
+    // start() holds layoutLock and every queue's lock while it lays out a
+    // frame, so rects may be read under any one queue lock
+    mutable QMutex layoutLock;
+    QSize size;
+    QAtomicInt generation;
+    QVector<QRect> rects;
+    QVector<Queue *> queues;
+    QVector<TileCaches *> tileCaches;
+};
+
+#endif // TILESCHEDULER_H
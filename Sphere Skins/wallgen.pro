@@ -26,7 +26,17 @@ SOURCES += \
     historydisplay.cpp \
     iothread.cpp \
     polarplane.cpp \
-    tiltplane.cpp
+    tiltplane.cpp \
+    polyhedral.cpp \
+    polartables.cpp \
+    fft.cpp \
+    legendre.cpp \
+    coordinategrid.cpp \
+    basiscache.cpp \
+    fieldcache.cpp \
+    tilescheduler.cpp \
+    rendertarget.cpp \
+    framegovernor.cpp
 
 HEADERS  += \
     interface.h \
@@ -43,7 +53,18 @@ HEADERS  += \
     historydisplay.h \
     iothread.h \
     polarplane.h \
-    tiltplane.h
+    tiltplane.h \
+    powerladder.h \
+    polyhedral.h \
+    polartables.h \
+    fft.h \
+    legendre.h \
+    coordinategrid.h \
+    basiscache.h \
+    fieldcache.h \
+    tilescheduler.h \
+    rendertarget.h \
+    framegovernor.h
 
 RESOURCES += \
     softwareresources.qrc
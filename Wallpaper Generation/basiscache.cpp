@@ -0,0 +1,122 @@
+#include "basiscache.h"
+
+#include <cmath>
+
+JobKey::JobKey(const AbstractFunction *function, const FunctionPlan &plan, const QSharedPointer<CoordinateGrid> &grid,
+               int firstColumn, int firstRow, int columns, int rows, int mode)
+    : family(&typeid(*function)), grid(grid), firstColumn(firstColumn), firstRow(firstRow), columns(columns), rows(rows),
+      mode(mode)
+{
+    frequencies.reserve(plan.terms.size());
+    for (int k = 0; k < plan.terms.size(); k++)
+        frequencies.push_back(qMakePair(plan.terms[k].n, plan.terms[k].m));
+}
+
+bool JobKey::operator==(const JobKey &other) const
+{
+    return family && other.family && *family == *other.family && frequencies == other.frequencies
+        && grid == other.grid && firstColumn == other.firstColumn && firstRow == other.firstRow
+        && columns == other.columns && rows == other.rows && mode == other.mode;
+}
+
+BasisCache::Lookup BasisCache::lookup(const JobKey &job, qint64 budget)
+{
+    bool repeated = job == key;
+    if (repeated && built)
+        return BASIS_HIT;
+
+    key = job;
+    built = false;
+    summed = false;
+
+    // the planes of the whole preview, with every tile of it cached
+    int terms = job.frequencies.size();
+    qint64 bytes = qint64(terms + 1) * 2 * sizeof(double) * job.grid->columns() * job.grid->rows();
+    if (!repeated || terms == 0 || bytes > budget) {
+        basisRe.clear();
+        basisIm.clear();
+        sumRe.clear();
+        sumIm.clear();
+        return BASIS_MISS;
+    }
+
+    columns = job.columns;
+    rows = job.rows;
+    basisRe.resize(terms * columns * rows);
+    basisIm.resize(terms * columns * rows);
+    sumRe.resize(columns * rows);
+    sumIm.resize(columns * rows);
+    finite.fill(true, terms);
+    weights.resize(terms);
+
+    return BASIS_BUILD;
+}
+
+void BasisCache::finishBuilding()
+{
+    int plane = columns * rows;
+    for (int k = 0; k < finite.size(); k++)
+    {
+        const double *re = basisRe.constData() + k * plane;
+        const double *im = basisIm.constData() + k * plane;
+        for (int j = 0; j < plane && finite[k]; j++)
+            finite[k] = std::isfinite(re[j]) && std::isfinite(im[j]);
+    }
+
+    built = true;
+    summed = false;
+}
+
+// field += weight * b_k over the whole job
+void BasisCache::accumulate(int k, std::complex<double> weight)
+{
+    int plane = columns * rows;
+    const double *re = basisRe.constData() + k * plane;
+    const double *im = basisIm.constData() + k * plane;
+    double *outRe = sumRe.data();
+    double *outIm = sumIm.data();
+    double wr = weight.real(), wi = weight.imag();
+
+    for (int j = 0; j < plane; j++)
+    {
+        outRe[j] += wr * re[j] - wi * im[j];
+        outIm[j] += wr * im[j] + wi * re[j];
+    }
+}
+
+void BasisCache::combine(const FunctionPlan &plan)
+{
+    int terms = plan.terms.size();
+    int changed = -1, changes = 0;
+    if (summed) {
+        for (int k = 0; k < terms; k++)
+        {
+            if (plan.terms[k].coeff != weights[k]) {
+                changed = k;
+                changes++;
+            }
+        }
+        if (changes == 0)
+            return;
+    }
+
+    // a delta on a plane with poles would leave inf - inf behind, so those
+    // terms are always re-summed
+    if (summed && changes == 1 && finite[changed] && deltas < BASIS_RESUM_INTERVAL) {
+        accumulate(changed, plan.terms[changed].coeff - weights[changed]);
+        deltas++;
+    } else {
+        sumRe.fill(0.0);
+        sumIm.fill(0.0);
+        // terms left out of a draft carry no weight, and skipping their
+        // planes keeps any poles in them out of the field
+        for (int k = 0; k < terms; k++)
+            if (plan.terms[k].coeff != 0.0)
+                accumulate(k, plan.terms[k].coeff);
+        deltas = 0;
+    }
+
+    for (int k = 0; k < terms; k++)
+        weights[k] = plan.terms[k].coeff;
+    summed = true;
+}
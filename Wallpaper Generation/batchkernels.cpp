@@ -0,0 +1,398 @@
+#include "batchkernels.h"
+
+#include <cmath>
+
+#if (defined(__GNUC__) || defined(__clang__)) && (defined(__x86_64__) || defined(__i386__))
+#define BATCH_X86 1
+#include <immintrin.h>
+#define BATCH_TARGET_SSE2 __attribute__((target("sse2")))
+#define BATCH_TARGET_AVX2 __attribute__((target("avx2,fma")))
+#else
+#define BATCH_X86 0
+#endif
+
+// a plan's waves flattened into per-wave arrays, with the lattice basis
+// folded in so that the phase of wave j is just kx[j]*x + ky[j]*y
+struct WaveTable
+{
+    QVector<double> kx, ky, cr, ci;
+    int size;
+
+    explicit WaveTable(const FunctionPlan &plan) : size(plan.waves.size())
+    {
+        kx.resize(size); ky.resize(size);
+        cr.resize(size); ci.resize(size);
+
+        for (int j = 0; j < size; j++)
+        {
+            const PlanTerm &wave = plan.waves[j];
+            kx[j] = wave.n * plan.Xx + wave.m * plan.Yx;
+            ky[j] = wave.n * plan.Xy + wave.m * plan.Yy;
+            cr[j] = wave.coeff.real();
+            ci[j] = wave.coeff.imag();
+        }
+    }
+};
+
+typedef void (*LatticeKernel)(const WaveTable &table, const double *x, const double *y, int start, int count, double *re, double *im);
+
+static void latticeKernelScalar(const WaveTable &table, const double *x, const double *y, int start, int count, double *re, double *im)
+{
+    for (int k = start; k < count; k++)
+    {
+        double sumRe = 0.0, sumIm = 0.0;
+        for (int j = 0; j < table.size; j++)
+        {
+            double t = table.kx[j] * x[k] + table.ky[j] * y[k];
+            double c = std::cos(t), s = std::sin(t);
+            sumRe += table.cr[j] * c - table.ci[j] * s;
+            sumIm += table.cr[j] * s + table.ci[j] * c;
+        }
+        re[k] = sumRe;
+        im[k] = sumIm;
+    }
+}
+
+#if BATCH_X86
+
+// Vector sin/cos, after the cephes double routines: reduce by pi/2 in three
+// parts (Cody-Waite), evaluate the minimax polynomials on [-pi/4, pi/4] and
+// fix up the quadrant. The quadrant is read off the low mantissa bits of
+// t*2/pi + 1.5*2^52, which also rounds it to the nearest integer.
+namespace
+{
+    const double TWO_OVER_PI = 0.63661977236758134308;
+    const double ROUND_MAGIC = 6755399441055744.0;
+    const double DP1 = 1.57079625129699707031;
+    const double DP2 = 7.54978941586159635336E-8;
+    const double DP3 = 5.3903028581581190529E-15;
+
+    const double S0 = 1.58962301576546568060E-10;
+    const double S1 = -2.50507477628578072866E-8;
+    const double S2 = 2.75573136213857245213E-6;
+    const double S3 = -1.98412698295895385996E-4;
+    const double S4 = 8.33333333332211858878E-3;
+    const double S5 = -1.66666666666666307295E-1;
+
+    const double C0 = -1.13585365213876817300E-11;
+    const double C1 = 2.08757008419747316778E-9;
+    const double C2 = -2.75573141792967388112E-7;
+    const double C3 = 2.48015872888517045348E-5;
+    const double C4 = -1.38888888888730564116E-3;
+    const double C5 = 4.16666666666665929218E-2;
+}
+
+BATCH_TARGET_SSE2 static inline void sincosSSE2(__m128d t, __m128d *sinOut, __m128d *cosOut)
+{
+    const __m128d magic = _mm_set1_pd(ROUND_MAGIC);
+    __m128d qm = _mm_add_pd(_mm_mul_pd(t, _mm_set1_pd(TWO_OVER_PI)), magic);
+    __m128d q = _mm_sub_pd(qm, magic);
+    __m128i qi = _mm_castpd_si128(qm);
+
+    __m128d r = _mm_sub_pd(t, _mm_mul_pd(q, _mm_set1_pd(DP1)));
+    r = _mm_sub_pd(r, _mm_mul_pd(q, _mm_set1_pd(DP2)));
+    r = _mm_sub_pd(r, _mm_mul_pd(q, _mm_set1_pd(DP3)));
+    __m128d z = _mm_mul_pd(r, r);
+
+    __m128d ps = _mm_set1_pd(S0);
+    ps = _mm_add_pd(_mm_mul_pd(ps, z), _mm_set1_pd(S1));
+    ps = _mm_add_pd(_mm_mul_pd(ps, z), _mm_set1_pd(S2));
+    ps = _mm_add_pd(_mm_mul_pd(ps, z), _mm_set1_pd(S3));
+    ps = _mm_add_pd(_mm_mul_pd(ps, z), _mm_set1_pd(S4));
+    ps = _mm_add_pd(_mm_mul_pd(ps, z), _mm_set1_pd(S5));
+    __m128d sinr = _mm_add_pd(r, _mm_mul_pd(_mm_mul_pd(r, z), ps));
+
+    __m128d pc = _mm_set1_pd(C0);
+    pc = _mm_add_pd(_mm_mul_pd(pc, z), _mm_set1_pd(C1));
+    pc = _mm_add_pd(_mm_mul_pd(pc, z), _mm_set1_pd(C2));
+    pc = _mm_add_pd(_mm_mul_pd(pc, z), _mm_set1_pd(C3));
+    pc = _mm_add_pd(_mm_mul_pd(pc, z), _mm_set1_pd(C4));
+    pc = _mm_add_pd(_mm_mul_pd(pc, z), _mm_set1_pd(C5));
+    __m128d cosr = _mm_add_pd(_mm_sub_pd(_mm_set1_pd(1.0), _mm_mul_pd(_mm_set1_pd(0.5), z)), _mm_mul_pd(_mm_mul_pd(z, z), pc));
+
+    // odd quadrants swap sin and cos; SSE2 has no 64-bit compare, so the
+    // low bit is shifted up to the sign and smeared across the lane
+    const __m128i one = _mm_set1_epi64x(1);
+    const __m128i two = _mm_set1_epi64x(2);
+    __m128i swapBit = _mm_slli_epi64(_mm_and_si128(qi, one), 63);
+    __m128d swap = _mm_castsi128_pd(_mm_shuffle_epi32(_mm_srai_epi32(swapBit, 31), _MM_SHUFFLE(3, 3, 1, 1)));
+    __m128d s = _mm_or_pd(_mm_and_pd(swap, cosr), _mm_andnot_pd(swap, sinr));
+    __m128d c = _mm_or_pd(_mm_and_pd(swap, sinr), _mm_andnot_pd(swap, cosr));
+
+    // sin is negative in quadrants 2,3 and cos in quadrants 1,2
+    __m128d sinSign = _mm_castsi128_pd(_mm_slli_epi64(_mm_and_si128(qi, two), 62));
+    __m128d cosSign = _mm_castsi128_pd(_mm_slli_epi64(_mm_and_si128(_mm_add_epi64(qi, one), two), 62));
+    *sinOut = _mm_xor_pd(s, sinSign);
+    *cosOut = _mm_xor_pd(c, cosSign);
+}
+
+BATCH_TARGET_SSE2 static void latticeKernelSSE2(const WaveTable &table, const double *x, const double *y, int start, int count, double *re, double *im)
+{
+    int k = start;
+    for (; k + 2 <= count; k += 2)
+    {
+        __m128d px = _mm_loadu_pd(x + k);
+        __m128d py = _mm_loadu_pd(y + k);
+        __m128d sumRe = _mm_setzero_pd();
+        __m128d sumIm = _mm_setzero_pd();
+
+        for (int j = 0; j < table.size; j++)
+        {
+            __m128d t = _mm_add_pd(_mm_mul_pd(_mm_set1_pd(table.kx[j]), px), _mm_mul_pd(_mm_set1_pd(table.ky[j]), py));
+            __m128d s, c;
+            sincosSSE2(t, &s, &c);
+
+            __m128d cr = _mm_set1_pd(table.cr[j]);
+            __m128d ci = _mm_set1_pd(table.ci[j]);
+            sumRe = _mm_add_pd(sumRe, _mm_sub_pd(_mm_mul_pd(cr, c), _mm_mul_pd(ci, s)));
+            sumIm = _mm_add_pd(sumIm, _mm_add_pd(_mm_mul_pd(cr, s), _mm_mul_pd(ci, c)));
+        }
+
+        _mm_storeu_pd(re + k, sumRe);
+        _mm_storeu_pd(im + k, sumIm);
+    }
+
+    latticeKernelScalar(table, x, y, k, count, re, im);
+}
+
+BATCH_TARGET_AVX2 static inline void sincosAVX2(__m256d t, __m256d *sinOut, __m256d *cosOut)
+{
+    const __m256d magic = _mm256_set1_pd(ROUND_MAGIC);
+    __m256d qm = _mm256_fmadd_pd(t, _mm256_set1_pd(TWO_OVER_PI), magic);
+    __m256d q = _mm256_sub_pd(qm, magic);
+    __m256i qi = _mm256_castpd_si256(qm);
+
+    __m256d r = _mm256_fnmadd_pd(q, _mm256_set1_pd(DP1), t);
+    r = _mm256_fnmadd_pd(q, _mm256_set1_pd(DP2), r);
+    r = _mm256_fnmadd_pd(q, _mm256_set1_pd(DP3), r);
+    __m256d z = _mm256_mul_pd(r, r);
+
+    __m256d ps = _mm256_set1_pd(S0);
+    ps = _mm256_fmadd_pd(ps, z, _mm256_set1_pd(S1));
+    ps = _mm256_fmadd_pd(ps, z, _mm256_set1_pd(S2));
+    ps = _mm256_fmadd_pd(ps, z, _mm256_set1_pd(S3));
+    ps = _mm256_fmadd_pd(ps, z, _mm256_set1_pd(S4));
+    ps = _mm256_fmadd_pd(ps, z, _mm256_set1_pd(S5));
+    __m256d sinr = _mm256_fmadd_pd(_mm256_mul_pd(r, z), ps, r);
+
+    __m256d pc = _mm256_set1_pd(C0);
+    pc = _mm256_fmadd_pd(pc, z, _mm256_set1_pd(C1));
+    pc = _mm256_fmadd_pd(pc, z, _mm256_set1_pd(C2));
+    pc = _mm256_fmadd_pd(pc, z, _mm256_set1_pd(C3));
+    pc = _mm256_fmadd_pd(pc, z, _mm256_set1_pd(C4));
+    pc = _mm256_fmadd_pd(pc, z, _mm256_set1_pd(C5));
+    __m256d cosr = _mm256_fmadd_pd(_mm256_mul_pd(z, z), pc, _mm256_fnmadd_pd(_mm256_set1_pd(0.5), z, _mm256_set1_pd(1.0)));
+
+    // blendv only looks at the sign bit, so the shifted quadrant bits
+    // serve directly as masks
+    const __m256i one = _mm256_set1_epi64x(1);
+    const __m256i two = _mm256_set1_epi64x(2);
+    __m256d swap = _mm256_castsi256_pd(_mm256_slli_epi64(_mm256_and_si256(qi, one), 63));
+    __m256d s = _mm256_blendv_pd(sinr, cosr, swap);
+    __m256d c = _mm256_blendv_pd(cosr, sinr, swap);
+
+    __m256d sinSign = _mm256_castsi256_pd(_mm256_slli_epi64(_mm256_and_si256(qi, two), 62));
+    __m256d cosSign = _mm256_castsi256_pd(_mm256_slli_epi64(_mm256_and_si256(_mm256_add_epi64(qi, one), two), 62));
+    *sinOut = _mm256_xor_pd(s, sinSign);
+    *cosOut = _mm256_xor_pd(c, cosSign);
+}
+
+BATCH_TARGET_AVX2 static void latticeKernelAVX2(const WaveTable &table, const double *x, const double *y, int start, int count, double *re, double *im)
+{
+    int k = start;
+    for (; k + 4 <= count; k += 4)
+    {
+        __m256d px = _mm256_loadu_pd(x + k);
+        __m256d py = _mm256_loadu_pd(y + k);
+        __m256d sumRe = _mm256_setzero_pd();
+        __m256d sumIm = _mm256_setzero_pd();
+
+        for (int j = 0; j < table.size; j++)
+        {
+            __m256d t = _mm256_fmadd_pd(_mm256_set1_pd(table.kx[j]), px, _mm256_mul_pd(_mm256_set1_pd(table.ky[j]), py));
+            __m256d s, c;
+            sincosAVX2(t, &s, &c);
+
+            __m256d cr = _mm256_set1_pd(table.cr[j]);
+            __m256d ci = _mm256_set1_pd(table.ci[j]);
+            sumRe = _mm256_fmadd_pd(cr, c, sumRe);
+            sumRe = _mm256_fnmadd_pd(ci, s, sumRe);
+            sumIm = _mm256_fmadd_pd(cr, s, sumIm);
+            sumIm = _mm256_fmadd_pd(ci, c, sumIm);
+        }
+
+        _mm256_storeu_pd(re + k, sumRe);
+        _mm256_storeu_pd(im + k, sumIm);
+    }
+
+    latticeKernelScalar(table, x, y, k, count, re, im);
+}
+
+#endif // BATCH_X86
+
+struct NamedKernel
+{
+    const char *name;
+    LatticeKernel kernel;
+};
+
+// the kernels the CPU supports, widest last
+static QVector<NamedKernel> availableKernels()
+{
+    QVector<NamedKernel> kernels;
+    NamedKernel scalar = { "scalar", latticeKernelScalar };
+    kernels.push_back(scalar);
+
+#if BATCH_X86
+    __builtin_cpu_init();
+
+    if (__builtin_cpu_supports("sse2")) {
+        NamedKernel sse2 = { "SSE2", latticeKernelSSE2 };
+        kernels.push_back(sse2);
+    }
+    // MinGW doesn't keep the stack 32-byte aligned for spilled AVX
+    // registers, so Windows builds stop at SSE2
+#if !defined(_WIN32)
+    if (__builtin_cpu_supports("avx2") && __builtin_cpu_supports("fma")) {
+        NamedKernel avx2 = { "AVX2", latticeKernelAVX2 };
+        kernels.push_back(avx2);
+    }
+#endif
+#endif
+
+    return kernels;
+}
+
+static const QVector<NamedKernel> &kernels()
+{
+    static const QVector<NamedKernel> available = availableKernels();
+    return available;
+}
+
+void evaluateLatticeBatch(const FunctionPlan &plan, const double *x, const double *y, int count, double *re, double *im)
+{
+    static const LatticeKernel kernel = kernels().last().kernel;
+
+    WaveTable table(plan);
+    kernel(table, x, y, 0, count, re, im);
+}
+
+int latticeKernelCount()
+{
+    return kernels().size();
+}
+
+const char *latticeKernelName(int kernel)
+{
+    return kernels()[kernel].name;
+}
+
+void evaluateLatticeKernel(int kernel, const FunctionPlan &plan, const double *x, const double *y, int count, double *re, double *im)
+{
+    WaveTable table(plan);
+    kernels()[kernel].kernel(table, x, y, 0, count, re, im);
+}
+
+void evaluateLatticeScanline(const FunctionPlan &plan, double x0, double y0, double dx, double dy, int count, double *re, double *im)
+{
+    WaveTable table(plan);
+    QVector<double> phaseRe(table.size), phaseIm(table.size);
+    QVector<double> stepRe(table.size), stepIm(table.size);
+
+    for (int j = 0; j < table.size; j++)
+    {
+        double t = table.kx[j] * dx + table.ky[j] * dy;
+        stepRe[j] = std::cos(t);
+        stepIm[j] = std::sin(t);
+    }
+
+    for (int start = 0; start < count; start += RECURRENCE_RESEED_INTERVAL)
+    {
+        int end = qMin(start + RECURRENCE_RESEED_INTERVAL, count);
+
+        // seed every wave directly at the first point of the block, so the
+        // rounding error of the rotations never builds up past one block
+        double x = x0 + start * dx;
+        double y = y0 + start * dy;
+        for (int j = 0; j < table.size; j++)
+        {
+            double t = table.kx[j] * x + table.ky[j] * y;
+            double c = std::cos(t), s = std::sin(t);
+            phaseRe[j] = table.cr[j] * c - table.ci[j] * s;
+            phaseIm[j] = table.cr[j] * s + table.ci[j] * c;
+        }
+
+        for (int k = start; k < end; k++)
+        {
+            double sumRe = 0.0, sumIm = 0.0;
+            for (int j = 0; j < table.size; j++)
+            {
+                sumRe += phaseRe[j];
+                sumIm += phaseIm[j];
+
+                double rotatedRe = phaseRe[j] * stepRe[j] - phaseIm[j] * stepIm[j];
+                phaseIm[j] = phaseRe[j] * stepIm[j] + phaseIm[j] * stepRe[j];
+                phaseRe[j] = rotatedRe;
+            }
+            re[k] = sumRe;
+            im[k] = sumIm;
+        }
+    }
+}
+
+void PhaseTables::build(const FunctionPlan &plan, const double *xs, int columns, const double *ys, int rows)
+{
+    WaveTable table(plan);
+    this->waves = table.size;
+    this->columns = columns;
+    this->rows = rows;
+
+    columnRe.resize(columns * waves);
+    columnIm.resize(columns * waves);
+    for (int c = 0; c < columns; c++)
+    {
+        for (int j = 0; j < waves; j++)
+        {
+            double t = table.kx[j] * xs[c];
+            double cs = std::cos(t), sn = std::sin(t);
+            columnRe[c * waves + j] = table.cr[j] * cs - table.ci[j] * sn;
+            columnIm[c * waves + j] = table.cr[j] * sn + table.ci[j] * cs;
+        }
+    }
+
+    rowRe.resize(waves * rows);
+    rowIm.resize(waves * rows);
+    for (int j = 0; j < waves; j++)
+    {
+        for (int r = 0; r < rows; r++)
+        {
+            double t = table.ky[j] * ys[r];
+            rowRe[j * rows + r] = std::cos(t);
+            rowIm[j * rows + r] = std::sin(t);
+        }
+    }
+}
+
+void PhaseTables::evaluateColumn(int column, int firstRow, int count, double *re, double *im) const
+{
+    for (int r = 0; r < count; r++)
+    {
+        re[r] = 0.0;
+        im[r] = 0.0;
+    }
+
+    const double *cRe = columnRe.constData() + column * waves;
+    const double *cIm = columnIm.constData() + column * waves;
+    for (int j = 0; j < waves; j++)
+    {
+        const double a = cRe[j], b = cIm[j];
+        const double *pRe = rowRe.constData() + j * rows + firstRow;
+        const double *pIm = rowIm.constData() + j * rows + firstRow;
+
+        for (int r = 0; r < count; r++)
+        {
+            re[r] += a * pRe[r] - b * pIm[r];
+            im[r] += a * pIm[r] + b * pRe[r];
+        }
+    }
+}
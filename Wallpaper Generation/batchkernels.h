@@ -0,0 +1,47 @@
+#ifndef BATCHKERNELS_H
+#define BATCHKERNELS_H
+
+#include "functions.h"
+
+// Batch evaluation of a lattice function's plane waves,
+//   re[k] + i*im[k] = sum_j waves[j].coeff * ei(kx_j * x[k] + ky_j * y[k])
+// The widest kernel the CPU supports (AVX2+FMA, SSE2, or plain scalar) is
+// picked once on first use and then reused by every render thread.
+void evaluateLatticeBatch(const FunctionPlan &plan, const double *x, const double *y, int count, double *re, double *im);
+
+// The kernels evaluateLatticeBatch() can pick from on this CPU, the scalar
+// one first and the one it picks last, for checking them against each
+// other (see checks/checks.cpp)
+int latticeKernelCount();
+const char *latticeKernelName(int kernel);
+void evaluateLatticeKernel(int kernel, const FunctionPlan &plan, const double *x, const double *y, int count, double *re, double *im);
+
+// Same sum over the evenly spaced points (x0 + k*dx, y0 + k*dy), k < count.
+// Along such a line each wave is a geometric sequence, so after seeding its
+// phase it only takes one complex multiply per point to advance; the phases
+// are re-seeded from scratch every RECURRENCE_RESEED_INTERVAL points.
+const int RECURRENCE_RESEED_INTERVAL = 64;
+void evaluateLatticeScanline(const FunctionPlan &plan, double x0, double y0, double dx, double dy, int count, double *re, double *im);
+
+// On an axis-aligned grid of points (xs[c], ys[r]) every wave factors as
+//   coeff * ei(kx*x + ky*y) = (coeff * ei(kx*xs[c])) * ei(ky*ys[r])
+// so one table over the columns and one over the rows per wave are enough
+// to sum the whole grid with complex multiply-adds. The tables take
+// (columns + rows) * waves complex entries and as many sin/cos pairs.
+class PhaseTables
+{
+public:
+    PhaseTables() : waves(0), columns(0), rows(0) { }
+
+    void build(const FunctionPlan &plan, const double *xs, int columns, const double *ys, int rows);
+    // rows firstRow .. firstRow+count-1 of the column
+    void evaluateColumn(int column, int firstRow, int count, double *re, double *im) const;
+    bool isEmpty() const { return columns == 0 || rows == 0; }
+
+private:
+    int waves, columns, rows;
+    QVector<double> columnRe, columnIm;     // [column * waves + j], coefficient folded in
+    QVector<double> rowRe, rowIm;           // [j * rows + row]
+};
+
+#endif // BATCHKERNELS_H
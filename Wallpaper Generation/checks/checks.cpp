@@ -0,0 +1,166 @@
+#include <QDebug>
+#include <QVector>
+
+#include "functions.h"
+#include "batchkernels.h"
+#include "shared.h"
+
+/*
+ *
+ *  Consistency checks of the evaluation kernels, run without the GUI:
+ *  the scanline recurrence and every SIMD kernel are compared against the
+ *  per-pixel bundle() sums they replace. Exits with the number of failed
+ *  checks.
+ *
+ */
+
+// the phase recurrence of evaluateScanline() against bundle(), for every
+// wallpaper group. The columns run the height of an export, so they go
+// through many reseeds (see RECURRENCE_RESEED_INTERVAL), and one sits far
+// out in the plane, where the phases are large
+static const double SCANLINE_TOLERANCE = 1e-9;
+
+// a few terms with mixed frequencies and coefficients
+static void setTerms(AbstractFunction *function)
+{
+    int terms = 4;
+    function->setNumTerms(terms);
+    for (unsigned int k = 0; k < (unsigned int) terms; k++) {
+        int n = 1 + 2 * k, m = (int) k - 2;
+        double r = 1.0 / (k + 1), a = 0.7 * k;
+        function->setN(k, n);
+        function->setM(k, m);
+        function->setR(k, r);
+        function->setA(k, a);
+    }
+}
+
+static int checkScanlines(const QVector<AbstractFunction *> &functions)
+{
+    const int count = DEFAULT_OUTPUT_HEIGHT;
+    const double pitch = DEFAULT_WORLD_HEIGHT / DEFAULT_OUTPUT_HEIGHT;
+    const double columns[] = { DEFAULT_XCORNER, 0.37, 523.1 };
+    int failures = 0;
+
+    for (int f = 0; f < functions.size(); f++)
+    {
+        // functions without a lattice form are summed directly anyway
+        if (!functions[f]->compile().lattice)
+            continue;
+
+        AbstractFunction *function = functions[f]->clone();
+        setTerms(function);
+
+        for (unsigned int c = 0; c < sizeof(columns) / sizeof(columns[0]); c++) {
+            double error = function->scanlineError(columns[c], DEFAULT_YCORNER + DEFAULT_WORLD_HEIGHT, 0.0, -pitch, count);
+            if (error > SCANLINE_TOLERANCE) {
+                qWarning() << "checkScanlines: function" << f << "is off from bundle() by" << error << "at x =" << columns[c];
+                failures++;
+            }
+        }
+
+        delete function;
+    }
+
+    return failures;
+}
+
+// every lattice kernel the CPU can run (see latticeKernelCount()) against
+// the scalar one and against bundle(), for every wallpaper group. The
+// points cover the default world rectangle and a patch far out, where the
+// SIMD sin/cos have to reduce large phases; their count is odd so that the
+// kernels' scalar tails are run as well
+static const double KERNEL_TOLERANCE = 1e-9;
+
+static int checkKernels(const QVector<AbstractFunction *> &functions)
+{
+    const int side = 33;
+    const double corners[][2] = { { DEFAULT_XCORNER, DEFAULT_YCORNER }, { 523.1, -347.9 } };
+    QVector<double> x, y;
+    for (unsigned int p = 0; p < sizeof(corners) / sizeof(corners[0]); p++)
+        for (int i = 0; i < side; i++)
+            for (int j = 0; j < side; j++) {
+                x.push_back(corners[p][0] + DEFAULT_WORLD_WIDTH * i / side);
+                y.push_back(corners[p][1] + DEFAULT_WORLD_HEIGHT * j / side);
+            }
+    x.push_back(0.0);
+    y.push_back(0.0);
+    int count = x.size();
+
+    QVector<double> scalarRe(count), scalarIm(count), re(count), im(count);
+    int failures = 0;
+
+    for (int f = 0; f < functions.size(); f++)
+    {
+        if (!functions[f]->compile().lattice)
+            continue;
+
+        AbstractFunction *function = functions[f]->clone();
+        setTerms(function);
+        FunctionPlan plan = function->compile();
+
+        double magnitude = 0.0;
+        for (int k = 0; k < plan.waves.size(); k++)
+            magnitude += std::abs(plan.waves[k].coeff);
+
+        evaluateLatticeKernel(0, plan, x.constData(), y.constData(), count, scalarRe.data(), scalarIm.data());
+
+        for (int kernel = 0; kernel < latticeKernelCount(); kernel++) {
+            double error = function->batchError(kernel, x.constData(), y.constData(), count);
+            if (error > KERNEL_TOLERANCE) {
+                qWarning() << "checkKernels:" << latticeKernelName(kernel) << "kernel of function" << f
+                           << "is off from bundle() by" << error;
+                failures++;
+            }
+
+            evaluateLatticeKernel(kernel, plan, x.constData(), y.constData(), count, re.data(), im.data());
+            double difference = 0.0;
+            for (int k = 0; k < count; k++)
+                difference = qMax(difference, std::abs(std::complex<double>(re[k] - scalarRe[k], im[k] - scalarIm[k])));
+            if (magnitude > 0.0)
+                difference /= magnitude;
+            if (difference > KERNEL_TOLERANCE) {
+                qWarning() << "checkKernels:" << latticeKernelName(kernel) << "kernel of function" << f
+                           << "is off from the scalar kernel by" << difference;
+                failures++;
+            }
+        }
+
+        delete function;
+    }
+
+    return failures;
+}
+
+int main()
+{
+    QVector<AbstractFunction *> functions;
+    functions.push_back(new hex3Function());
+    functions.push_back(new hex6Function());
+    functions.push_back(new squareFunction());
+    functions.push_back(new generalpairedFunction());
+    functions.push_back(new generalFunction());
+    functions.push_back(new cmmFunction());
+    functions.push_back(new p31mFunction());
+    functions.push_back(new p3m1Function());
+    functions.push_back(new p6mFunction());
+    functions.push_back(new p4gFunction());
+    functions.push_back(new p4mFunction());
+    functions.push_back(new pmmFunction());
+    functions.push_back(new pmgFunction());
+    functions.push_back(new pggFunction());
+    functions.push_back(new pmFunction());
+    functions.push_back(new pgFunction());
+    functions.push_back(new rhombicFunction());
+    functions.push_back(new zzbarFunction());
+
+    int failures = checkScanlines(functions);
+    failures += checkKernels(functions);
+
+    for (int f = 0; f < functions.size(); f++)
+        delete functions[f];
+
+    if (failures == 0)
+        qDebug() << "checks: all passed";
+    return failures;
+}
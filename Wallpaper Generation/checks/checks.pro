@@ -0,0 +1,31 @@
+#-------------------------------------------------
+#
+# Console checks of the evaluation kernels (scanline recurrence and
+# SIMD batch kernels) against bundle(),
+# without the GUI. Build and run from this folder:
+#     qmake && make && ./checks
+# The exit status is the number of failed checks.
+#
+#-------------------------------------------------
+
+QT       += core gui
+QT       += widgets
+
+TARGET = checks
+TEMPLATE = app
+
+CONFIG += console
+CONFIG -= app_bundle
+
+INCLUDEPATH += ..
+
+SOURCES += \
+    checks.cpp \
+    ../functions.cpp \
+    ../batchkernels.cpp
+
+HEADERS  += \
+    ../functions.h \
+    ../batchkernels.h \
+    ../powerladder.h \
+    ../shared.h
@@ -4,31 +4,33 @@ ControllerThread::ControllerThread(AbstractFunction *function, ColorWheel *color
 {
     QMutexLocker locker(&mutex);
     
-    numThreadsActive = 0;
-    
     NUM_THREADS = idealThreadCount() != -1 ? idealThreadCount() : 8;
     
     //NUM_THREADS = 1;         //for testing
     
-    restart = false;
-    abort = false;
+    restart.storeRelease(0);
+    abort.storeRelease(0);
+    progressive = true;
+    finestStep = 1;
     
     currFunction = function;
     currColorWheel = colorwheel;
     currSettings = settings;
     
     this->controllerObject = controllerObject;
-    this->controllerObject->setNumThreadsActive(NUM_THREADS);
     
-    qRegisterMetaType<Q2DArray>("Q2DArray");
+    scheduler.setWorkers(NUM_THREADS);
+    scheduler.setTileSize(QSize(RENDER_TILE_WIDTH, RENDER_TILE_HEIGHT));
+    
     qRegisterMetaType<ComplexValue>("ComplexValue");
     
     for (int i = 0; i < NUM_THREADS; i++) {
         RenderThread *nextThread = new RenderThread(currFunction, currColorWheel, currSettings, outputSize);
         threads.push_back(nextThread);
-        connect(nextThread, SIGNAL(renderingFinished(QPoint, Q2DArray)), controllerObject, SLOT(handleRenderedImageParts(QPoint, Q2DArray)));
-        connect(nextThread, SIGNAL(newProgress(double)), controllerObject, SLOT(handleNewProgress(double)));
+        connect(nextThread, SIGNAL(tileFinished(int, QRect)), controllerObject, SLOT(handleFinishedTile(int, QRect)));
         connect(nextThread, SIGNAL(newImageDataPoint(ComplexValue)), controllerObject, SLOT(addNewImageDataPoint(ComplexValue)));
+        connect(nextThread, SIGNAL(termsSkipped(int)), controllerObject, SLOT(handleTermsSkipped(int)));
+        connect(nextThread, SIGNAL(periodGridRejected(bool)), controllerObject, SLOT(handlePeriodGridRejected(bool)));
     }
     
     connect(this, SIGNAL(finished()), this, SLOT(deleteLater()));
@@ -37,8 +39,8 @@ ControllerThread::ControllerThread(AbstractFunction *function, ColorWheel *color
 ControllerThread::~ControllerThread()
 {
     mutex.lock();
-    restart = false;
-    abort = true;
+    restart.storeRelease(0);
+    abort.storeRelease(1);
     
     restartCondition.wakeOne();
     mutex.unlock();
@@ -46,7 +48,7 @@ ControllerThread::~ControllerThread()
     wait();
 }
 
-void ControllerThread::prepareToRun(QImage *output, const int &actionFlag)
+void ControllerThread::prepareToRun(const QSharedPointer<RenderTarget> &output, const int &actionFlag)
 {
     
     QMutexLocker locker(&mutex);
@@ -60,102 +62,154 @@ void ControllerThread::prepareToRun(QImage *output, const int &actionFlag)
         threads[i]->changeFunction(imageFunction);
         threads[i]->changeColorWheel(imageColorWheel);
         threads[i]->changeSettings(imageSettings);
+        threads[i]->setActionFlag(actionFlag);
     }
     
-    this->output = output;
+    target = output;
     overallWidth = output->width();
     overallHeight = output->height();
     this->actionFlag = actionFlag;
+    finestStep = 1;
     controllerObject->setActionFlag(this->actionFlag);
-    controllerObject->setOutput(this->output);
-    
-    numThreadsActive = threads.size();
-    
-    controllerObject->setNumThreadsRunning(numThreadsActive);
     
     if (!isRunning()) {
         start(InheritPriority);
     }
     else {
+        scheduler.cancel();
         controllerObject->setRestart(true);
-        restart = true;
+        restart.storeRelease(1);
         emit newWork();
         restartCondition.wakeOne();
     }
     
 }
 
-void ControllerThread::prepareToRun(Display *display, const int &actionFlag)
+void ControllerThread::prepareToRun(Display *display, const int &actionFlag, int finestStep)
 {
     
     QMutexLocker locker(&mutex);
     
     
-    this->display = display;
-    overallWidth = display->getWidth();
-    overallHeight = display->getHeight();
+    target = display->getTarget();
+    overallWidth = target->width();
+    overallHeight = target->height();
     this->actionFlag = actionFlag;
-    controllerObject->setActionFlag(this->actionFlag);
-    controllerObject->setDisplay(this->display);
+    this->finestStep = qBound(1, finestStep, PREVIEW_COARSEST_STEP);
     
-    numThreadsActive = threads.size();
+    // the threads' coordinate grid has to cover the frame laid out over
+    // the target, or the tiles would read past its columns and rows
+    for (int i = 0; i < threads.size(); i++) {
+        threads[i]->setActionFlag(actionFlag);
+        threads[i]->changeDimensions(overallWidth, overallHeight);
+    }
     
-    controllerObject->setNumThreadsRunning(numThreadsActive);
+    controllerObject->setActionFlag(this->actionFlag);
     
     if (!isRunning()) {
         start(InheritPriority);
     }
     else {
+        scheduler.cancel();
         controllerObject->setRestart(true);
-        restart = true;
+        restart.storeRelease(1);
         emit newWork();
         restartCondition.wakeOne();
     }
 }
 
+// tiles the target with copies of the block at its top left, row by row
+// so that new work stops it early; returns whether it got through
+bool ControllerThread::copyBlock(const QSharedPointer<RenderTarget> &output, const QSize &block)
+{
+    TileView view = output->view(QRect(0, 0, output->width(), output->height()));
+    
+    for (int y = 0; y < output->height(); y++)
+    {
+        if (restart.loadAcquire() || abort.loadAcquire()) return false;
+        
+        int sourceY = y % block.height();
+        for (int x = y < block.height() ? block.width() : 0; x < output->width(); x++) {
+            view.setPixel(x, y, view.pixel(x % block.width(), sourceY));
+        }
+    }
+    
+    return true;
+}
+
 void ControllerThread::run()
 {
     forever {
-        if (abort) return;
+        if (abort.loadAcquire()) return;
         
+        // a preview is drawn in passes, one pixel in PREVIEW_COARSEST_STEP
+        // first and halving the step down to every pixel (or to finestStep
+        // while the user is interacting with it), so that it shows up well
+        // before the full render is done; new work drops the passes that
+        // are left
         mutex.lock();
+        bool passes = actionFlag == DISPLAY_REPAINT_FLAG && (progressive || finestStep > 1);
+        int step = passes ? PREVIEW_COARSEST_STEP : 1;
+        int lastStep = passes ? finestStep : 1;
+        QSize frameSize(overallWidth, overallHeight);
+        QSharedPointer<RenderTarget> output = target;
+        mutex.unlock();
         
-        int width = overallWidth;
-        int height = overallHeight;
-        int counter = overallWidth/numThreadsActive;
+        // only the block that the lattice repeats over the whole frame is
+        // laid out into tiles; the rest of the frame is copied from it once
+        // a pass is done. The frame's periods are taken before tiling, as a
+        // tile narrower than a period would have nothing to copy. The plan
+        // and what evaluating it takes are made here, once for all passes
+        // and tiles
+        QSharedPointer<FrameEvaluation> evaluation = threads[0]->prepareFrame(frameSize.width(), frameSize.height());
+        QSize block = evaluation->block();
+        bool copying = block != frameSize;
         
-        for (int i = 0; i < numThreadsActive; i++)
+        for (; step >= lastStep && !restart.loadAcquire(); step /= 2)
         {
-            if (restart) break;
-            if (abort) return;
-            if (i == numThreadsActive - 1) {
-                threads[i]->render(QPoint(i * counter, 0), QPoint(width, height), &allWorkersFinishedCondition);
-            }
-            else {
-                threads[i]->render(QPoint(i * counter, 0), QPoint((i + 1) * counter, height), &allWorkersFinishedCondition);
+            mutex.lock();
+            
+            // every thread works through the tiles of the new frame, stealing
+            // from the others once its own share is done
+            int frame = scheduler.start(block.width(), block.height());
+            controllerObject->startFrame(frame, scheduler.tileCount(), step == lastStep, copying);
+            
+            for (int i = 0; i < threads.size(); i++)
+            {
+                if (restart.loadAcquire()) break;
+                if (abort.loadAcquire()) return;
+                threads[i]->render(&scheduler, frame, i, target, evaluation, step, step == lastStep,
+                                   &allWorkersFinishedCondition);
             }
-        }
+            
+            mutex.unlock();
         
-        mutex.unlock();
-        
-        // std::chrono::steady_clock::time_point begin = std::chrono::steady_clock::now();
-        
-        if (!restart) {
-            QEventLoop q;
-            connect(this, SIGNAL(newWork()), &q, SLOT(quit()));
-            connect(controllerObject, SIGNAL(allThreadsFinished()), &q, SLOT(quit()));
-            q.exec();
+            // std::chrono::steady_clock::time_point begin = std::chrono::steady_clock::now();
+            
+            if (!restart.loadAcquire()) {
+                QEventLoop q;
+                connect(this, SIGNAL(newWork()), &q, SLOT(quit()));
+                connect(controllerObject, SIGNAL(allThreadsFinished()), &q, SLOT(quit()));
+                
+                // new work may have come in before the connections were made
+                if (!restart.loadAcquire())
+                    q.exec();
+            }
+            
+            if (copying && copyBlock(output, block)) {
+                controllerObject->finishCopies(QRect(0, 0, output->width(), output->height()));
+            }
+            
+            // std::chrono::steady_clock::time_point end = std::chrono::steady_clock::now();
+            // qDebug() << "TIME TO RENDER ALL PIXELS:" << (std::chrono::duration_cast<std::chrono::microseconds>(end - begin).count()) / pow(10, 6) << "seconds";
         }
         
-        // std::chrono::steady_clock::time_point end = std::chrono::steady_clock::now();
-        // qDebug() << "TIME TO RENDER ALL PIXELS:" << (std::chrono::duration_cast<std::chrono::microseconds>(end - begin).count()) / pow(10, 6) << "seconds";
-        
         mutex.lock();
-        if (!restart) {
+        if (!restart.loadAcquire()) {
             restartCondition.wait(&mutex);
         }
         
-        restart = false;
+        restart.storeRelease(0);
         controllerObject->setRestart(false);
         mutex.unlock();
     }
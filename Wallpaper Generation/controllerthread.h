@@ -9,21 +9,37 @@ class Controller : public QObject
 {
     Q_OBJECT
 public:
-    Controller(QObject *parent = 0) : QObject(parent) { }
+    Controller(QObject *parent = 0) : QObject(parent) { restart.storeRelease(0); frame = 0; finalPass = true; copying = false; }
     ~Controller() { }
-    explicit Controller(Display *display, QImage *output, QObject *parent = 0) : QObject(parent) {
-        this->display = display;
-        this->output = output;
-        restart = false;
+    // the frame (scheduler generation) and tiles of the next pass; only
+    // the last pass of a render finishes the work and reports progress,
+    // unless the rest of the frame is still to be copied from the
+    // evaluated block, which then finishes it in finishCopies()
+    void startFrame(int frame, int tiles, bool finalPass, bool copying) {
+        this->frame = frame;
+        numTiles = numTilesPending = tiles;
+        this->finalPass = finalPass;
+        this->copying = copying;
     }
-    int getNumThreadsRunning() { return numThreadsRunning; }
-    int getNumThreadsActive() { return numThreadsActive; }
-    void setNumThreadsRunning(int value) { numThreadsRunning = value; }
-    void setNumThreadsActive(int value) { numThreadsActive = value; }
+    
+    // the pass's copies of the evaluated block are in the render target
+    void finishCopies(const QRect &copied) {
+        if (restart.loadAcquire()) {
+            return;
+        }
+        
+        if (actionFlag != IMAGE_EXPORT_FLAG) {
+            emit tileReady(copied);
+        }
+        
+        if (finalPass) {
+            emit workFinished(actionFlag);
+            emit partialProgressChanged(100);
+        }
+    }
+    
     void setActionFlag(int flag) { actionFlag = flag; }
-    void setDisplay(Display *display) { this->display = display; }
-    void setOutput(QImage *output) { this->output = output; }
-    void setRestart(bool status) { restart = status; }
+    void setRestart(bool status) { restart.storeRelease(status); }
     
 signals:
     void workFinished(const int &actionFlag);
@@ -31,83 +47,75 @@ signals:
     void progressChanged(const int &progress);
     void partialProgressChanged(const double &progress);
     void newImageDataPoint(const ComplexValue &data);
+    void termsSkipped(int count);
+    void periodGridRejected(bool rejected);
+    void tileReady(const QRect &rect);
     
 private:
-    int numThreadsRunning;
-    int numThreadsActive;
+    int frame;
+    int numTiles;
+    int numTilesPending;
+    bool finalPass;
+    bool copying;
     int actionFlag;
-    QImage *output;     //for file writing
-    Display *display;   //for display repainting
-    bool restart;
-    void repaintWork(Display *display, const QPoint &startPoint, const Q2DArray &result) {
-        int width = result.size();
-        int height = result[0].size();
-        int translatedX = startPoint.x();
-        int translatedY = startPoint.y();
-        for (int x = 0; x < width; x++) {
-            if (restart) return;
-            for (int y = 0; y < height; y++) {
-                if (restart) return;
-                display->setPixel(translatedX + x, translatedY + y, result[x][y]);
-            }
-        }
-    }
-    void repaintWork(QImage *output, const QPoint &startPoint, const Q2DArray &result) {
-        int width = result.size();
-        int height = result[0].size();
-        int translatedX = startPoint.x();
-        int translatedY = startPoint.y();
-        for (int x = 0; x < width; x++) {
-            if (restart) return;
-            for (int y = 0; y < height; y++) {
-                if (restart) return;
-                output->setPixel(translatedX + x, translatedY + y, result[x][y]);
-            }
-        }
-    }
+    QAtomicInt restart;         // written from both the GUI and the controller thread
     
     private slots:
-    void handleRenderedImageParts(const QPoint &startPoint, const Q2DArray &result) {
-        if (restart) {
+    // the tile's pixels are already in the render target; a display only
+    // has to repaint that rectangle of it. Tiles of a superseded frame,
+    // queued before the next one started, are dropped
+    void handleFinishedTile(int frame, const QRect &rect) {
+        if (restart.loadAcquire() || frame != this->frame) {
             return;
         }
         
-        switch (actionFlag) {
-            case DISPLAY_REPAINT_FLAG:
-            case HISTORY_ICON_REPAINT_FLAG:
-                repaintWork(display, startPoint, result);
-                break;
-            case IMAGE_EXPORT_FLAG:
-                repaintWork(output, startPoint, result);
-                break;
+        if (actionFlag != IMAGE_EXPORT_FLAG) {
+            emit tileReady(rect);
         }
         
-        --numThreadsRunning;
+        --numTilesPending;
         
-        if (numThreadsRunning == 0) {
-            restart = false;
+        if (numTilesPending > 0) {
+            if (finalPass) {
+                emit partialProgressChanged(100.0 * (numTiles - numTilesPending) / numTiles);
+            }
+        } else {
+            restart.storeRelease(0);
             
             //quit the event loop
             emit allThreadsFinished();
             
-            //signal to the port object
-            emit workFinished(actionFlag);
-            
-            //signal to update progress bar
-            emit partialProgressChanged(100);
+            if (finalPass && !copying) {
+                //signal to the port object
+                emit workFinished(actionFlag);
+                
+                //signal to update progress bar
+                emit partialProgressChanged(100);
+            }
         }
     }
     
-    void handleNewProgress(const double &progress) {
-        if (restart) {
+    void addNewImageDataPoint(const ComplexValue &data) {
+        emit newImageDataPoint(data);
+    }
+    
+    // every thread reports the same count, from the same plan and pitch;
+    // only the preview's is shown, not that of the history icons
+    void handleTermsSkipped(int count) {
+        if (restart.loadAcquire() || actionFlag != DISPLAY_REPAINT_FLAG) {
             return;
         }
         
-        emit partialProgressChanged(progress * numThreadsRunning / numThreadsActive);
+        emit termsSkipped(count);
     }
     
-    void addNewImageDataPoint(const ComplexValue &data) {
-        emit newImageDataPoint(data);
+    // likewise for whether the period grid was too far off to be used
+    void handlePeriodGridRejected(bool rejected) {
+        if (restart.loadAcquire() || actionFlag != DISPLAY_REPAINT_FLAG) {
+            return;
+        }
+        
+        emit periodGridRejected(rejected);
     }
 };
 
@@ -119,8 +127,24 @@ public:
     ControllerThread(QObject *parent = 0) : QThread(parent) { }
     explicit ControllerThread(AbstractFunction *function, ColorWheel *colorwheel, Settings *settings, Controller *controllerObject, const QSize &outputSize, QObject *parent = 0);
     ~ControllerThread();
-    void prepareToRun(QImage *output, const int &actionFlag);
-    void prepareToRun(Display *display, const int &actionFlag);
+    void prepareToRun(const QSharedPointer<RenderTarget> &output, const int &actionFlag);
+    // finestStep over 1 stops a preview at that coarse pass.
+    //
+    // Requests are coalesced: the frame in flight is superseded at once
+    // (see TileScheduler::cancel), and whatever came in by the time the
+    // next frame is laid out is rendered as one request, from the latest
+    // state
+    void prepareToRun(Display *display, const int &actionFlag, int finestStep = 1);
+    
+    // takes effect from the next render on; 0 stands for the whole image
+    void setTileSize(const QSize &size) { scheduler.setTileSize(size); }
+    
+    // whether previews are drawn coarse to fine; takes effect from the
+    // next render on
+    void setProgressive(bool status) {
+        QMutexLocker locker(&mutex);
+        progressive = status;
+    }
     
     // GETTERS
     Controller* getControllerObject() {return controllerObject;}
@@ -165,23 +189,29 @@ signals:
     void newWork();
     
    private:
+    bool copyBlock(const QSharedPointer<RenderTarget> &output, const QSize &block);
+    
     QMutex mutex;
     QWaitCondition allWorkersFinishedCondition;
     QWaitCondition restartCondition;
     
-    bool restart, abort;
+    // set under the mutex by prepareToRun(), but polled by run() while
+    // the mutex is released for the passes
+    QAtomicInt restart;
+    QAtomicInt abort;           // polled by run() outside the mutex
+    bool progressive;
     
-    int numThreadsActive;
     int overallWidth, overallHeight;
     int actionFlag;
+    int finestStep;
     
     AbstractFunction *currFunction;
     ColorWheel *currColorWheel;
     Settings *currSettings;
     Controller *controllerObject;
-    Display *display;
-    QImage *output;
+    QSharedPointer<RenderTarget> target;
     QVector<RenderThread *> threads;
+    TileScheduler scheduler;
     
 };
 
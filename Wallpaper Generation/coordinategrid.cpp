@@ -0,0 +1,48 @@
+#include "coordinategrid.h"
+
+#include <QMutex>
+#include <QMutexLocker>
+
+CoordinateGrid::CoordinateGrid(const Settings &settings, int columns, int rows)
+    : width(settings.Width), height(settings.Height), xCorner(settings.XCorner), yCorner(settings.YCorner),
+      columnCount(columns), rowCount(rows), columnX(columns), rowY(rows)
+{
+    double worldXStart = width / columns;
+    for (int x = 0; x < columns; x++)
+        columnX[x] = x * worldXStart + xCorner;
+
+    double worldYStart1 = height + yCorner;
+    double worldYStart2 = height / rows;
+    for (int y = 0; y < rows; y++)
+        rowY[y] = worldYStart1 - y * worldYStart2;
+}
+
+bool CoordinateGrid::matches(const Settings &settings, int columns, int rows) const
+{
+    return width == settings.Width && height == settings.Height && xCorner == settings.XCorner
+        && yCorner == settings.YCorner && columnCount == columns && rowCount == rows;
+}
+
+QSharedPointer<CoordinateGrid> CoordinateGrid::shared(const Settings &settings, int columns, int rows)
+{
+    static QMutex cacheMutex;
+    static QList<QSharedPointer<CoordinateGrid> > cache;   // most recently used first
+
+    QMutexLocker locker(&cacheMutex);
+
+    for (int k = 0; k < cache.size(); k++)
+    {
+        if (cache[k]->matches(settings, columns, rows)) {
+            QSharedPointer<CoordinateGrid> grid = cache[k];
+            cache.move(k, 0);
+            return grid;
+        }
+    }
+
+    QSharedPointer<CoordinateGrid> grid(new CoordinateGrid(settings, columns, rows));
+    cache.prepend(grid);
+    while (cache.size() > COORDINATE_GRID_CACHE_SIZE)
+        cache.removeLast();
+
+    return grid;
+}
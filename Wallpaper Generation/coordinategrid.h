@@ -0,0 +1,41 @@
+#ifndef COORDINATEGRID_H
+#define COORDINATEGRID_H
+
+#include <QSharedPointer>
+#include <QVector>
+
+#include "shared.h"
+
+// how many grids CoordinateGrid::shared() keeps alive between renders
+// (typically the preview, the history icons and the last export)
+const int COORDINATE_GRID_CACHE_SIZE = 3;
+
+// The world point (worldX, worldY) of every pixel of an overallWidth x
+// overallHeight render, keyed by the world rectangle (Settings Width/Height/
+// XCorner/YCorner) and output size. The grid is separable, so only the
+// per-column worldX and per-row worldY are kept; an evaluator that needs
+// per-pixel points gathers them a column at a time (see FieldEvaluator).
+// Once built, the grid is shared read-only by every RenderThread, so
+// re-rendering after a coefficient change regenerates no coordinates at
+// all, and keeping a grid cached costs only its two axes even at export
+// size.
+class CoordinateGrid
+{
+public:
+    static QSharedPointer<CoordinateGrid> shared(const Settings &settings, int columns, int rows);
+
+    int columns() const { return columnCount; }
+    int rows() const { return rowCount; }
+    const double *worldX() const { return columnX.constData(); }     // of each column
+    const double *worldY() const { return rowY.constData(); }        // of each row
+
+private:
+    CoordinateGrid(const Settings &settings, int columns, int rows);
+    bool matches(const Settings &settings, int columns, int rows) const;
+
+    double width, height, xCorner, yCorner;
+    int columnCount, rowCount;
+    QVector<double> columnX, rowY;
+};
+
+#endif // COORDINATEGRID_H
@@ -5,15 +5,8 @@ Display::Display(double imageWidth, double imageHeight, QWidget *parent) :
 {
     width = imageWidth;
     height = imageHeight;
-    disp = QImage(width, height, QImage::Format_RGB32);
-    disp.fill(0);
-
-    colorMap = QVector<QVector<QRgb>>(width, QVector<QRgb>(height));
-}
-
-void Display::setPixel(int i, int j, QRgb color)
-{
-    colorMap[i][j] = color;
+    target = QSharedPointer<RenderTarget>(new RenderTarget(width, height));
+    target->fill(0);
 }
 
 void Display::mousePressEvent(QMouseEvent *event) 
@@ -47,23 +40,28 @@ QSize Display::changeDisplayDimensions(double width, double height) {
         this->width = this->height * (double)(width/height);
     }
 
+    // the render threads lay the frame out over the target, so it has to
+    // follow the display's size
+    QSize size(this->width, this->height);
+    if (size != sizeHint()) {
+        target = QSharedPointer<RenderTarget>(new RenderTarget(size.width(), size.height()));
+        target->fill(0);
+    }
+
     resetSize();
     
-    return QSize(this->width, this->height);
+    return size;
 
 }
 
-void Display::paintEvent(QPaintEvent * /* unused */)
+void Display::paintEvent(QPaintEvent *event)
 {
+    // only the tiles that finished since the last paint are dirty, and the
+    // frame is already in the QImage's own format, so this is one blit
     QPainter painter(this);
-    QColor color;
-
-    for (int i = 0; i < width; i++) {
-        for (int j = 0; j < height; j++) {
-            color = QColor::fromRgb(colorMap[i][j]);
-            painter.setPen(color);
-            painter.drawPoint(i, j);
-        }
-    }
+    const QImage &image = target->image();
+    QRect dirty = event->rect().intersected(image.rect());
 
+    if (!dirty.isEmpty())
+        painter.drawImage(dirty.topLeft(), image, dirty);
 }
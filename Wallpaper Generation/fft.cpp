@@ -0,0 +1,120 @@
+#include "fft.h"
+
+#include <cmath>
+
+#include <QVarLengthArray>
+#include <QtGlobal>
+
+typedef std::complex<double> Complex;
+
+static const double TWO_PI = 6.28318530717958647692;
+
+int smoothLength(int n)
+{
+    for (int length = n < 1 ? 1 : n; ; length++)
+    {
+        int rest = length;
+        while (rest % 2 == 0) rest /= 2;
+        while (rest % 3 == 0) rest /= 3;
+        while (rest % 5 == 0) rest /= 5;
+        if (rest == 1) return length;
+    }
+}
+
+static int smallestFactor(int n)
+{
+    for (int p = 2; p * p <= n; p++)
+        if (n % p == 0) return p;
+    return n;
+}
+
+// Recursive decimation in time: out[k] = sum_j in[j*stride] * w^(jk), where
+// w = roots[rootStep] is the n-th root of unity out of a table of N of them.
+// The n inputs split into p interleaved subsequences of length m = n/p whose
+// transforms are recombined with one p-point butterfly per output column.
+static void transform(const Complex *in, Complex *out, int n, int stride, const Complex *roots, int rootStep, int N)
+{
+    if (n == 1) {
+        out[0] = in[0];
+        return;
+    }
+
+    int p = smallestFactor(n);
+    int m = n / p;
+    for (int r = 0; r < p; r++)
+        transform(in + r * stride, out + r * m, m, stride * p, roots, rootStep * p, N);
+
+    QVarLengthArray<Complex, 8> twiddled(p);
+    int butterflyStep = N / p;
+
+    for (int k = 0; k < m; k++)
+    {
+        for (int r = 0; r < p; r++)
+            twiddled[r] = out[r * m + k] * roots[r * k * rootStep];
+
+        if (p == 2) {
+            out[k] = twiddled[0] + twiddled[1];
+            out[m + k] = twiddled[0] - twiddled[1];
+            continue;
+        }
+
+        for (int q = 0; q < p; q++)
+        {
+            Complex sum = twiddled[0];
+            for (int r = 1; r < p; r++)
+                sum += twiddled[r] * roots[((r * q) % p) * butterflyStep];
+            out[q * m + k] = sum;
+        }
+    }
+}
+
+static QVector<Complex> rootsOfUnity(int n, int sign)
+{
+    QVector<Complex> roots(n);
+    for (int t = 0; t < n; t++)
+        roots[t] = std::polar(1.0, sign * TWO_PI * t / n);
+    return roots;
+}
+
+// transforms data in place, using scratch (n entries) for the input copy
+static void transformInPlace(Complex *data, int n, const QVector<Complex> &roots, QVector<Complex> &scratch)
+{
+    for (int j = 0; j < n; j++)
+        scratch[j] = data[j];
+
+    transform(scratch.constData(), data, n, 1, roots.constData(), 1, n);
+}
+
+void fft(Complex *data, int n, int sign)
+{
+    if (n <= 1) return;
+
+    QVector<Complex> scratch(n);
+    transformInPlace(data, n, rootsOfUnity(n, sign), scratch);
+}
+
+void fft2D(QVector<Complex> &data, int rows, int columns, int sign)
+{
+    QVector<Complex> scratch(qMax(rows, columns));
+
+    if (columns > 1) {
+        QVector<Complex> roots = rootsOfUnity(columns, sign);
+        for (int r = 0; r < rows; r++)
+            transformInPlace(data.data() + r * columns, columns, roots, scratch);
+    }
+
+    if (rows > 1) {
+        QVector<Complex> roots = rootsOfUnity(rows, sign);
+        QVector<Complex> column(rows);
+        for (int c = 0; c < columns; c++)
+        {
+            for (int r = 0; r < rows; r++)
+                column[r] = data[r * columns + c];
+
+            transformInPlace(column.data(), rows, roots, scratch);
+
+            for (int r = 0; r < rows; r++)
+                data[r * columns + c] = column[r];
+        }
+    }
+}
@@ -0,0 +1,23 @@
+#ifndef FFT_H
+#define FFT_H
+
+#include <complex>
+
+#include <QVector>
+
+// Self-contained mixed-radix FFT. Lengths are split into their prime
+// factors, with the butterflies for 2, 3 and 5 being the cheap ones;
+// smoothLength() rounds a length up to the next 2^a 3^b 5^c.
+//
+// sign = +1 computes the (unnormalized) inverse transform
+//     out[k] = sum_j in[j] * e^(+2 pi i j k / n)
+// and sign = -1 the forward one.
+
+int smoothLength(int n);
+
+void fft(std::complex<double> *data, int n, int sign);
+
+// in-place 2D transform of a row-major rows x columns array
+void fft2D(QVector<std::complex<double> > &data, int rows, int columns, int sign);
+
+#endif // FFT_H
@@ -0,0 +1,60 @@
+#include "fieldcache.h"
+
+bool FieldCache::sameTerms(const JobKey &job, const FunctionPlan &plan) const
+{
+    if (!(job == key) || coefficients.size() != plan.terms.size())
+        return false;
+
+    for (int k = 0; k < plan.terms.size(); k++)
+        if (coefficients[k] != plan.terms[k].coeff)
+            return false;
+
+    return true;
+}
+
+bool FieldCache::holds(const JobKey &job, const FunctionPlan &plan) const
+{
+    return complete && sameTerms(job, plan);
+}
+
+bool FieldCache::holdsSketch(const JobKey &job, const FunctionPlan &plan, int step) const
+{
+    return !complete && sketchStep == step && sameTerms(job, plan);
+}
+
+void FieldCache::reset(const JobKey &job, const FunctionPlan &plan)
+{
+    key = job;
+    complete = false;
+    sketchStep = 0;
+
+    coefficients.resize(plan.terms.size());
+    for (int k = 0; k < plan.terms.size(); k++)
+        coefficients[k] = plan.terms[k].coeff;
+
+    rows = job.rows;
+    valuesRe.resize(job.columns * job.rows);
+    valuesIm.resize(job.columns * job.rows);
+}
+
+void FieldCache::store(int column, const double *re, const double *im)
+{
+    FieldSample *outRe = valuesRe.data() + column * rows;
+    FieldSample *outIm = valuesIm.data() + column * rows;
+    for (int y = 0; y < rows; y++)
+    {
+        outRe[y] = re[y];
+        outIm[y] = im[y];
+    }
+}
+
+void FieldCache::storeSamples(int column, int firstRow, int rowStep, int count, const double *re, const double *im)
+{
+    FieldSample *outRe = valuesRe.data() + column * rows;
+    FieldSample *outIm = valuesIm.data() + column * rows;
+    for (int i = 0; i < count; i++)
+    {
+        outRe[firstRow + i * rowStep] = re[i];
+        outIm[firstRow + i * rowStep] = im[i];
+    }
+}
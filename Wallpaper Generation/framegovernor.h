@@ -0,0 +1,52 @@
+#ifndef FRAMEGOVERNOR_H
+#define FRAMEGOVERNOR_H
+
+#include <QHash>
+#include <QPair>
+#include <QtGlobal>
+
+// how long an interactive preview frame may take, in milliseconds
+const double PREVIEW_FRAME_BUDGET = 33.0;
+
+// how soon after the last edit another one still counts as part of the
+// same interaction (a drag, scrubbing a spinbox), in milliseconds
+const int PREVIEW_SETTLE_INTERVAL = 250;
+
+// weight of the newest frame in the running cost of a combination
+const double FRAME_COST_SMOOTHING = 0.5;
+
+// Picks how coarse the preview is drawn while the user is interacting
+// with it. For each function/color wheel combination it keeps a running
+// estimate of what one sample of one term costs, learnt from the frames
+// it is told about, and the next interactive frame stops at the finest
+// pass step (see PREVIEW_COARSEST_STEP) that is expected to fit in the
+// frame budget.
+//
+// A frame superseded before it finished still says it took at least as
+// long as it ran, which keeps a drag whose frames never finish from
+// holding on to a step that is too fine.
+class FrameGovernor
+{
+public:
+    // functionSel and colorwheelSel indices
+    typedef QPair<int, int> Combination;
+
+    FrameGovernor(double budget = PREVIEW_FRAME_BUDGET) : budget(budget) { }
+
+    // the step the next interactive frame should stop at; the coarsest one
+    // until the combination has been timed
+    int interactiveStep(const Combination &combination, int pixels, int terms) const;
+
+    // a frame that stopped at step, elapsed milliseconds after it was asked
+    // for; unfinished if it was superseded first
+    void recordFrame(const Combination &combination, int step, int pixels, int terms, qint64 elapsed,
+                     bool finished);
+
+private:
+    static double samples(int step, int pixels, int terms);
+
+    double budget;
+    QHash<Combination, double> costs;       // milliseconds per sample and term
+};
+
+#endif // FRAMEGOVERNOR_H
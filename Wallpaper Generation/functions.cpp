@@ -1,4 +1,9 @@
 #include "functions.h"
+#include "powerladder.h"
+#include "batchkernels.h"
+
+#include <QMap>
+#include <QVarLengthArray>
 
 AbstractFunction::AbstractFunction(QVector<coeffpair> &in_coeffs, QVector<freqpair> &in_freqs)
 {
@@ -128,6 +133,298 @@ void AbstractFunction::refresh()
     scale.setA(0.0);
 }
 
+// appends one term to a plan, widening powerMin..powerMax to cover it
+static void addPlanTerm(FunctionPlan &plan, std::complex<double> coeff, int n, int m)
+{
+    PlanTerm term;
+    term.coeff = coeff;
+    term.n = n;
+    term.m = m;
+    plan.terms.push_back(term);
+    
+    plan.powerMin = qMin(plan.powerMin, qMin(n, m));
+    plan.powerMax = qMax(plan.powerMax, qMax(n, m));
+}
+
+// records the span of a plan's wave frequencies once expand() has run
+static void spanWaves(FunctionPlan &plan)
+{
+    for(int k = 0; k < plan.waves.size(); k++)
+    {
+        plan.nMin = qMin(plan.nMin, plan.waves[k].n);
+        plan.nMax = qMax(plan.nMax, plan.waves[k].n);
+        plan.mMin = qMin(plan.mMin, plan.waves[k].m);
+        plan.mMax = qMax(plan.mMax, plan.waves[k].m);
+    }
+}
+
+FunctionPlan AbstractFunction::compileTerms() const
+{
+    FunctionPlan plan;
+    std::complex<double> scaling = scale.combined();
+    
+    plan.terms.reserve(terms);
+    for(unsigned int k = 0; k < terms; k++)
+        addPlanTerm(plan, coeffs[k].combined() * scaling, freqs[k].N(), freqs[k].M());
+    
+    return plan;
+}
+
+FunctionPlan AbstractFunction::compile() const
+{
+    return compile(compileTerms());
+}
+
+// expands a term list from compileTerms(), leaving out the terms whose
+// coefficient is zero
+FunctionPlan AbstractFunction::compile(const FunctionPlan &terms) const
+{
+    FunctionPlan plan;
+    for(int k = 0; k < terms.terms.size(); k++)
+    {
+        const PlanTerm &term = terms.terms[k];
+        if(term.coeff != 0.0)
+            addPlanTerm(plan, term.coeff, term.n, term.m);
+    }
+    
+    expand(plan);
+    spanWaves(plan);
+    
+    return plan;
+}
+
+FunctionPlan AbstractFunction::compileTerm(unsigned int k) const
+{
+    FunctionPlan plan;
+    addPlanTerm(plan, 1.0, freqs[k].N(), freqs[k].M());
+    expand(plan);
+    spanWaves(plan);
+    
+    return plan;
+}
+
+// response of a pixel-wide box filter to a wave whose phase advances by
+// the given amount per pixel, or 0 from the Nyquist limit on
+static double pixelResponse(double phase)
+{
+    phase = qAbs(phase);
+    if(phase >= M_PI) return 0.0;
+    if(phase == 0.0) return 1.0;
+    return qSin(phase / 2) / (phase / 2);
+}
+
+// Draft renders leave out what their pixels cannot show. A term whose phase
+// advances by phi per pixel along an image axis is scaled by sinc(phi/2),
+// as if averaged over each pixel, and dropped from phi >= pi on, where it
+// would only alias into noise. Attenuated terms that end up under
+// DETAIL_THRESHOLD of the largest coefficient are dropped too. Dropped terms
+// keep their place with a zero coefficient; the count of them is returned.
+int AbstractFunction::limitDetail(FunctionPlan &terms, double xPitch, double yPitch) const
+{
+    double largest = 0.0;
+    for(int k = 0; k < terms.terms.size(); k++)
+        largest = qMax(largest, std::abs(terms.terms[k].coeff));
+    
+    int dropped = 0;
+    for(int k = 0; k < terms.terms.size(); k++)
+    {
+        PlanTerm &term = terms.terms[k];
+        if(term.coeff == 0.0) continue;
+        
+        double alongX, alongY;
+        termFrequencies(term, &alongX, &alongY);
+        double response = pixelResponse(alongX * xPitch) * pixelResponse(alongY * yPitch);
+        if(response < 1.0 && std::abs(term.coeff) * response < DETAIL_THRESHOLD * largest)
+            response = 0.0;
+        
+        term.coeff *= response;
+        if(response == 0.0) dropped++;
+    }
+    
+    return dropped;
+}
+
+// the fastest of the plane waves a term expands into, read off the lattice
+// basis: wave (n,m) has phase n*X + m*Y
+void AbstractFunction::termFrequencies(const PlanTerm &term, double *alongX, double *alongY) const
+{
+    FunctionPlan plan;
+    addPlanTerm(plan, 1.0, term.n, term.m);
+    expand(plan);
+    
+    *alongX = *alongY = 0.0;
+    if(!plan.lattice) return;
+    
+    for(int j = 0; j < plan.waves.size(); j++)
+    {
+        const PlanTerm &wave = plan.waves[j];
+        *alongX = qMax(*alongX, qAbs(wave.n * plan.Xx + wave.m * plan.Yx));
+        *alongY = qMax(*alongY, qAbs(wave.n * plan.Xy + wave.m * plan.Yy));
+    }
+}
+
+// fills ladder[p - lo] = e^p for lo <= p <= hi (lo <= 0 <= hi), working out
+// from e^0 by repeated multiplication; |e| = 1, so the negative powers come
+// from its conjugate
+static void fillLadder(std::complex<double> *ladder, const std::complex<double> &e, int lo, int hi)
+{
+    std::complex<double> *zero = ladder - lo;
+    std::complex<double> inverse = std::conj(e);
+    
+    zero[0] = 1.0;
+    for(int p = 1; p <= hi; p++)
+        zero[p] = zero[p - 1] * e;
+    for(int p = -1; p >= lo; p--)
+        zero[p] = zero[p + 1] * inverse;
+}
+
+// sums a lattice plan's waves at one point with only two calls to ei(): every
+// ei(n*X) and ei(m*Y) is read off a power ladder shared by all the terms and
+// all the parts of their orbits
+std::complex<double> AbstractFunction::evaluateLattice(const FunctionPlan &plan, double x, double y) const
+{
+    QVarLengthArray<std::complex<double>, 32> powX(plan.nMax - plan.nMin + 1);
+    QVarLengthArray<std::complex<double>, 32> powY(plan.mMax - plan.mMin + 1);
+    fillLadder(powX.data(), ei(plan.Xx * x + plan.Xy * y), plan.nMin, plan.nMax);
+    fillLadder(powY.data(), ei(plan.Yx * x + plan.Yy * y), plan.mMin, plan.mMax);
+    
+    std::complex<double> ans(0,0);
+    for(int k = 0; k < plan.waves.size(); k++)
+    {
+        const PlanTerm &wave = plan.waves[k];
+        ans += wave.coeff * powX[wave.n - plan.nMin] * powY[wave.m - plan.mMin];
+    }
+    
+    return ans;
+}
+
+// expands every term of the plan over the group's orbit into plan.waves.
+// Waves landing on the same frequency are merged, and those whose
+// coefficients cancel out (e.g. the N = 0 terms of pmgpg) are dropped
+void AbstractFunction::expandOrbits(FunctionPlan &plan, const WallpaperGroup &group)
+{
+    QMap<QPair<int, int>, std::complex<double> > merged;
+    double magnitude = 0.0;
+    
+    for(int k = 0; k < plan.terms.size(); k++)
+    {
+        const PlanTerm &term = plan.terms[k];
+        int N = term.n, M = term.m;
+        magnitude += std::abs(term.coeff);
+        
+        for(int op = 0; op < group.count; op++)
+        {
+            const OrbitOp &g = group.ops[op];
+            double weight = g.weight;
+            if((g.sign == NM_PARITY_SIGN && (N+M) % 2 != 0) || (g.sign == M_PARITY_SIGN && M % 2 != 0))
+                weight = -weight;
+            
+            merged[qMakePair(g.a*N + g.b*M, g.c*N + g.d*M)] += weight * term.coeff;
+        }
+    }
+    
+    plan.group = &group;
+    plan.waves.clear();
+    for(QMap<QPair<int, int>, std::complex<double> >::const_iterator it = merged.constBegin(); it != merged.constEnd(); ++it)
+    {
+        if(std::abs(it.value()) <= 1e-14 * magnitude)
+            continue;
+        
+        PlanTerm wave;
+        wave.coeff = it.value();
+        wave.n = it.key().first;
+        wave.m = it.key().second;
+        plan.waves.push_back(wave);
+    }
+}
+
+// evaluates a run of points into structure-of-arrays real/imaginary buffers;
+// lattice functions go through the vectorized Fourier kernels, everything
+// else falls back to one evaluate() per point
+void AbstractFunction::evaluateBatch(const FunctionPlan &plan, const double *x, const double *y, int count, double *re, double *im) const
+{
+    if (plan.lattice) {
+        evaluateLatticeBatch(plan, x, y, count, re, im);
+        return;
+    }
+    
+    for (int k = 0; k < count; k++) {
+        std::complex<double> ans = evaluate(plan, x[k], y[k]);
+        re[k] = ans.real();
+        im[k] = ans.imag();
+    }
+}
+
+// same, for the evenly spaced points (x0 + k*dx, y0 + k*dy) of a scanline;
+// lattice functions advance each wave's phase by rotation instead of
+// recomputing it at every point
+void AbstractFunction::evaluateScanline(const FunctionPlan &plan, double x0, double y0, double dx, double dy, int count, double *re, double *im) const
+{
+    if (plan.lattice) {
+        evaluateLatticeScanline(plan, x0, y0, dx, dy, count, re, im);
+        return;
+    }
+    
+    for (int k = 0; k < count; k++) {
+        std::complex<double> ans = evaluate(plan, x0 + k * dx, y0 + k * dy);
+        re[k] = ans.real();
+        im[k] = ans.imag();
+    }
+}
+
+// the largest distance, relative to the sum of |coeff|, between
+// evaluateScanline() and the per-pixel sum of bundle() that it replaces,
+// over the same scanline
+double AbstractFunction::scanlineError(double x0, double y0, double dx, double dy, int count) const
+{
+    FunctionPlan plan = compileTerms();
+    QVector<double> re(count), im(count);
+    evaluateScanline(compile(plan), x0, y0, dx, dy, count, re.data(), im.data());
+    
+    double magnitude = 0.0;
+    for (int k = 0; k < plan.terms.size(); k++)
+        magnitude += std::abs(plan.terms[k].coeff);
+    
+    double error = 0.0;
+    for (int k = 0; k < count; k++)
+    {
+        double x = x0 + k * dx, y = y0 + k * dy;
+        std::complex<double> ans(0,0);
+        for (unsigned int i = 0; i < terms; i++)
+            ans += plan.terms[i].coeff * bundle(x, y, i);
+        
+        error = qMax(error, std::abs(ans - std::complex<double>(re[k], im[k])));
+    }
+    
+    return magnitude > 0.0 ? error / magnitude : error;
+}
+
+// likewise between lattice kernel `kernel` (see latticeKernelCount()) and
+// bundle(), at the given points
+double AbstractFunction::batchError(int kernel, const double *x, const double *y, int count) const
+{
+    FunctionPlan plan = compileTerms();
+    QVector<double> re(count), im(count);
+    evaluateLatticeKernel(kernel, compile(plan), x, y, count, re.data(), im.data());
+    
+    double magnitude = 0.0;
+    for (int k = 0; k < plan.terms.size(); k++)
+        magnitude += std::abs(plan.terms[k].coeff);
+    
+    double error = 0.0;
+    for (int k = 0; k < count; k++)
+    {
+        double px = x[k], py = y[k];
+        std::complex<double> ans(0,0);
+        for (unsigned int i = 0; i < terms; i++)
+            ans += plan.terms[i].coeff * bundle(px, py, i);
+        
+        error = qMax(error, std::abs(ans - std::complex<double>(re[k], im[k])));
+    }
+    
+    return magnitude > 0.0 ? error / magnitude : error;
+}
+
 void AbstractFunction::initWithVectors(QVector<coeffpair> &in_coeffs, QVector<freqpair> &in_freqs)
 {
     terms = in_coeffs.size() < in_freqs.size() ? in_coeffs.size() : in_freqs.size();
@@ -148,35 +445,48 @@ void AbstractFunction::initWithVectors(QVector<coeffpair> &in_coeffs, QVector<fr
 
 std::complex<double> generalFunction::bundle(double &x, double &y, unsigned int &i) const
 {
-    int N, M;
-    N = freqs[i].N();
-    M = freqs[i].M();
+    return term(x, y, freqs[i].N(), freqs[i].M());
+}
+
+std::complex<double> generalFunction::term(double x, double y, int N, int M) const
+{
     std::complex<double> part1 = ei(N*Xgen + M*Ygen);
     
     return part1;
 }
 
-std::complex<double> generalFunction::operator ()(double i, double j)
+std::complex<double> generalFunction::evaluate(const FunctionPlan &plan, double i, double j) const
 {
-    std::complex<double> ans(0,0);
-    for(unsigned int k=0; k<terms; k++)
-    {
-        std::complex<double> thisterm = bundle(i, j, k);
-        thisterm *= coeffs[k].combined();
-        ans+= thisterm;
-    }
+    if (plan.lattice)
+        return evaluateLattice(plan, i, j);
     
-    ans *= scale.combined();
+    std::complex<double> ans(0,0);
+    for(int k = 0; k < plan.terms.size(); k++)
+        ans += plan.terms[k].coeff * term(i, j, plan.terms[k].n, plan.terms[k].m);
+
     return ans;
 }
 
+static const OrbitOp generalOps[] = {
+    { 1, 0, 0, 1, 1.0, NO_SIGN }
+};
+WALLPAPER_GROUP(generalGroup, generalOps);
+
+void generalFunction::expand(FunctionPlan &plan) const
+{
+    LATTICE_BASIS(plan, Xgen, Ygen);
+    expandOrbits(plan, generalGroup);
+}
+
 ////////////////////////////////////////////////////////////
 
 std::complex<double> generalpairedFunction::bundle(double &x, double &y, unsigned int &i) const
 {
-    int N,M;
-    N = freqs[i].N();
-    M = freqs[i].M();
+    return term(x, y, freqs[i].N(), freqs[i].M());
+}
+
+std::complex<double> generalpairedFunction::term(double x, double y, int N, int M) const
+{
     std::complex<double> part1 = ei(N*Xgen2 + M*Ygen2);
     std::complex<double> part2 = ei(-N*Xgen2 - M*Ygen2);
     
@@ -184,27 +494,39 @@ std::complex<double> generalpairedFunction::bundle(double &x, double &y, unsigne
     
 }
 
-std::complex<double> generalpairedFunction::operator ()(double i, double j)
+std::complex<double> generalpairedFunction::evaluate(const FunctionPlan &plan, double i, double j) const
 {
-    std::complex<double> ans(0,0);
-    for(unsigned int k = 0; k < terms; k++)
-    {
-        std::complex<double> thisterm = bundle(i, j, k);
-        thisterm *= coeffs[k].combined();
-        ans += thisterm;
-    }
+    if (plan.lattice)
+        return evaluateLattice(plan, i, j);
     
-    ans *= scale.combined();
+    std::complex<double> ans(0,0);
+    for(int k = 0; k < plan.terms.size(); k++)
+        ans += plan.terms[k].coeff * term(i, j, plan.terms[k].n, plan.terms[k].m);
+
     return ans;
 }
 
+static const OrbitOp generalpairedOps[] = {
+    { 1, 0, 0, 1, 1.0/2, NO_SIGN },
+    { -1, 0, 0, -1, 1.0/2, NO_SIGN }
+};
+WALLPAPER_GROUP(generalpairedGroup, generalpairedOps);
+
+void generalpairedFunction::expand(FunctionPlan &plan) const
+{
+    LATTICE_BASIS(plan, Xgen2, Ygen2);
+    expandOrbits(plan, generalpairedGroup);
+}
+
 ////////////////////////////////////////////////////////////
 
 std::complex<double> hex3Function::bundle(double &x, double &y, unsigned int &i) const
 {
-    int N,M;
-    N = freqs[i].N();
-    M = freqs[i].M();
+    return term(x, y, freqs[i].N(), freqs[i].M());
+}
+
+std::complex<double> hex3Function::term(double x, double y, int N, int M) const
+{
     std::complex<double> part1 = ei(N*Xhex3 + M*Yhex3);
     std::complex<double> part2 = ei((M)*Xhex3 - (N+M)*Yhex3);
     std::complex<double> part3 = ei(-(N+M)*Xhex3 + (N)*Yhex3);
@@ -213,29 +535,40 @@ std::complex<double> hex3Function::bundle(double &x, double &y, unsigned int &i)
     
 }
 
-std::complex<double> hex3Function::operator ()(double i, double j)
+std::complex<double> hex3Function::evaluate(const FunctionPlan &plan, double i, double j) const
 {
-    std::complex<double> ans(0,0);
+    if (plan.lattice)
+        return evaluateLattice(plan, i, j);
     
-    for(unsigned int k = 0; k < terms; k++)
-    {
-        std::complex<double> thisterm = bundle(i, j, k);
-        thisterm *= coeffs[k].combined();
-        ans += thisterm;
-    }
-    
-    ans *= scale.combined();
-    //qDebug()<<"ansX:"<<ans.real()<<"ansY:"<<ans.imag()<<"\n";
+    std::complex<double> ans(0,0);
+    for(int k = 0; k < plan.terms.size(); k++)
+        ans += plan.terms[k].coeff * term(i, j, plan.terms[k].n, plan.terms[k].m);
+
     return ans;
 }
 
+static const OrbitOp hex3Ops[] = {
+    { 1, 0, 0, 1, 1.0/3, NO_SIGN },
+    { 0, 1, -1, -1, 1.0/3, NO_SIGN },
+    { -1, -1, 1, 0, 1.0/3, NO_SIGN }
+};
+WALLPAPER_GROUP(hex3Group, hex3Ops);
+
+void hex3Function::expand(FunctionPlan &plan) const
+{
+    LATTICE_BASIS(plan, Xhex3, Yhex3);
+    expandOrbits(plan, hex3Group);
+}
+
 ////////////////////////////////////////////////////////////
 
 std::complex<double> p31mFunction::bundle(double &x, double &y, unsigned int &i) const
 {
-    int N,M;
-    N = freqs[i].N();
-    M = freqs[i].M();
+    return term(x, y, freqs[i].N(), freqs[i].M());
+}
+
+std::complex<double> p31mFunction::term(double x, double y, int N, int M) const
+{
     std::complex<double> part1 = ei(N*Xhex3 + M*Yhex3)+ei(M*Xhex3 + N*Yhex3);
     std::complex<double> part2 = ei((M)*Xhex3 - (N+M)*Yhex3)+ei(-(N+M)*Xhex3 + M*Yhex3);
     std::complex<double> part3 = ei(-(N+M)*Xhex3 + (N)*Yhex3)+ei(N*Xhex3 - (N+M)*Yhex3);
@@ -244,26 +577,42 @@ std::complex<double> p31mFunction::bundle(double &x, double &y, unsigned int &i)
     
 }
 
-std::complex<double> p31mFunction::operator ()(double i, double j)
+std::complex<double> p31mFunction::evaluate(const FunctionPlan &plan, double i, double j) const
 {
-    std::complex<double> ans(0,0);
-    for(unsigned int k=0; k<terms; k++)
-    {
-        std::complex<double> thisterm = bundle(i, j, k);
-        thisterm *= coeffs[k].combined();
-        ans+= thisterm;
-    }
+    if (plan.lattice)
+        return evaluateLattice(plan, i, j);
     
-    ans *= scale.combined();
+    std::complex<double> ans(0,0);
+    for(int k = 0; k < plan.terms.size(); k++)
+        ans += plan.terms[k].coeff * term(i, j, plan.terms[k].n, plan.terms[k].m);
+
     return ans;
 }
+
+static const OrbitOp p31mOps[] = {
+    { 1, 0, 0, 1, 1.0/6, NO_SIGN },
+    { 0, 1, 1, 0, 1.0/6, NO_SIGN },
+    { 0, 1, -1, -1, 1.0/6, NO_SIGN },
+    { -1, -1, 0, 1, 1.0/6, NO_SIGN },
+    { -1, -1, 1, 0, 1.0/6, NO_SIGN },
+    { 1, 0, -1, -1, 1.0/6, NO_SIGN }
+};
+WALLPAPER_GROUP(p31mGroup, p31mOps);
+
+void p31mFunction::expand(FunctionPlan &plan) const
+{
+    LATTICE_BASIS(plan, Xhex3, Yhex3);
+    expandOrbits(plan, p31mGroup);
+}
 ////////////////////////////////////////////////////////////
 
 std::complex<double> p3m1Function::bundle(double &x, double &y, unsigned int &i) const
 {
-    int N,M;
-    N = freqs[i].N();
-    M = freqs[i].M();
+    return term(x, y, freqs[i].N(), freqs[i].M());
+}
+
+std::complex<double> p3m1Function::term(double x, double y, int N, int M) const
+{
     std::complex<double> part1 = ei(N*Xhex3 + M*Yhex3)+ei(-M*Xhex3 - N*Yhex3);
     std::complex<double> part2 = ei((M)*Xhex3 - (N+M)*Yhex3)+ei((N+M)*Xhex3 - (M)*Yhex3);
     std::complex<double> part3 = ei(-(N+M)*Xhex3 + (N)*Yhex3)+ei(-(N)*Xhex3 + (N+M)*Yhex3);
@@ -272,28 +621,44 @@ std::complex<double> p3m1Function::bundle(double &x, double &y, unsigned int &i)
     
 }
 
-std::complex<double> p3m1Function::operator ()(double i, double j)
+std::complex<double> p3m1Function::evaluate(const FunctionPlan &plan, double i, double j) const
 {
-    std::complex<double> ans(0,0);
-    for(unsigned int k=0; k<terms; k++)
-    {
-        std::complex<double> thisterm = bundle(i, j, k);
-        thisterm *= coeffs[k].combined();
-        ans+= thisterm;
-    }
+    if (plan.lattice)
+        return evaluateLattice(plan, i, j);
     
-    ans *= scale.combined();
+    std::complex<double> ans(0,0);
+    for(int k = 0; k < plan.terms.size(); k++)
+        ans += plan.terms[k].coeff * term(i, j, plan.terms[k].n, plan.terms[k].m);
+
     return ans;
 }
 
+static const OrbitOp p3m1Ops[] = {
+    { 1, 0, 0, 1, 1.0/6, NO_SIGN },
+    { 0, -1, -1, 0, 1.0/6, NO_SIGN },
+    { 0, 1, -1, -1, 1.0/6, NO_SIGN },
+    { 1, 1, 0, -1, 1.0/6, NO_SIGN },
+    { -1, -1, 1, 0, 1.0/6, NO_SIGN },
+    { -1, 0, 1, 1, 1.0/6, NO_SIGN }
+};
+WALLPAPER_GROUP(p3m1Group, p3m1Ops);
+
+void p3m1Function::expand(FunctionPlan &plan) const
+{
+    LATTICE_BASIS(plan, Xhex3, Yhex3);
+    expandOrbits(plan, p3m1Group);
+}
+
 ////////////////////////////////////////////////////////////
 
 
 std::complex<double> hex6Function::bundle(double &x, double &y, unsigned int &i) const
 {
-    int N,M;
-    N = freqs[i].N();
-    M = freqs[i].M();
+    return term(x, y, freqs[i].N(), freqs[i].M());
+}
+
+std::complex<double> hex6Function::term(double x, double y, int N, int M) const
+{
     std::complex<double> part1 = qCos(N*Xhex6 + M*Yhex6);
     std::complex<double> part2 = qCos((M)*Xhex6 - (N+M)*Yhex6);
     std::complex<double> part3 = qCos(-(N+M)*Xhex6 + (N)*Yhex6);
@@ -301,27 +666,44 @@ std::complex<double> hex6Function::bundle(double &x, double &y, unsigned int &i)
     
 }
 
-std::complex<double> hex6Function::operator ()(double i, double j)
+std::complex<double> hex6Function::evaluate(const FunctionPlan &plan, double i, double j) const
 {
-    std::complex<double> ans(0,0);
-    for(unsigned int k=0; k<terms; k++)
-    {
-        std::complex<double> thisterm = bundle(i, j, k);
-        thisterm *= coeffs[k].combined();
-        ans+= thisterm;
-    }
+    if (plan.lattice)
+        return evaluateLattice(plan, i, j);
     
-    ans *= scale.combined();
+    std::complex<double> ans(0,0);
+    for(int k = 0; k < plan.terms.size(); k++)
+        ans += plan.terms[k].coeff * term(i, j, plan.terms[k].n, plan.terms[k].m);
+
     return ans;
 }
 
+// each qCos part is (ei(t) + ei(-t))/2
+static const OrbitOp hex6Ops[] = {
+    { 1, 0, 0, 1, 1.0/6, NO_SIGN },
+    { -1, 0, 0, -1, 1.0/6, NO_SIGN },
+    { 0, 1, -1, -1, 1.0/6, NO_SIGN },
+    { 0, -1, 1, 1, 1.0/6, NO_SIGN },
+    { -1, -1, 1, 0, 1.0/6, NO_SIGN },
+    { 1, 1, -1, 0, 1.0/6, NO_SIGN }
+};
+WALLPAPER_GROUP(hex6Group, hex6Ops);
+
+void hex6Function::expand(FunctionPlan &plan) const
+{
+    LATTICE_BASIS(plan, Xhex6, Yhex6);
+    expandOrbits(plan, hex6Group);
+}
+
 ///////////////////////////
 
 std::complex<double> p6mFunction::bundle(double &x, double &y, unsigned int &i) const
 {
-    int N,M;
-    N = freqs[i].N();
-    M = freqs[i].M();
+    return term(x, y, freqs[i].N(), freqs[i].M());
+}
+
+std::complex<double> p6mFunction::term(double x, double y, int N, int M) const
+{
     std::complex<double> part1 = qCos(N*Xhex6 + M*Yhex6);
     std::complex<double> part2 = qCos((M)*Xhex6 - (N+M)*Yhex6);
     std::complex<double> part3 = qCos(-(N+M)*Xhex6 + (N)*Yhex6);
@@ -332,79 +714,129 @@ std::complex<double> p6mFunction::bundle(double &x, double &y, unsigned int &i)
     
 }
 
-std::complex<double> p6mFunction::operator ()(double i, double j)
+std::complex<double> p6mFunction::evaluate(const FunctionPlan &plan, double i, double j) const
 {
-    std::complex<double> ans(0,0);
-    for(unsigned int k=0; k<terms; k++)
-    {
-        std::complex<double> thisterm = bundle(i, j, k);
-        thisterm *= coeffs[k].combined();
-        ans+= thisterm;
-    }
+    if (plan.lattice)
+        return evaluateLattice(plan, i, j);
     
-    ans *= scale.combined();
+    std::complex<double> ans(0,0);
+    for(int k = 0; k < plan.terms.size(); k++)
+        ans += plan.terms[k].coeff * term(i, j, plan.terms[k].n, plan.terms[k].m);
+
     return ans;
 }
 
+// each qCos part is (ei(t) + ei(-t))/2
+static const OrbitOp p6mOps[] = {
+    { 1, 0, 0, 1, 1.0/12, NO_SIGN },
+    { -1, 0, 0, -1, 1.0/12, NO_SIGN },
+    { 0, 1, -1, -1, 1.0/12, NO_SIGN },
+    { 0, -1, 1, 1, 1.0/12, NO_SIGN },
+    { -1, -1, 1, 0, 1.0/12, NO_SIGN },
+    { 1, 1, -1, 0, 1.0/12, NO_SIGN },
+    { 0, 1, 1, 0, 1.0/12, NO_SIGN },
+    { 0, -1, -1, 0, 1.0/12, NO_SIGN },
+    { 1, 0, -1, -1, 1.0/12, NO_SIGN },
+    { -1, 0, 1, 1, 1.0/12, NO_SIGN },
+    { -1, -1, 0, 1, 1.0/12, NO_SIGN },
+    { 1, 1, 0, -1, 1.0/12, NO_SIGN }
+};
+WALLPAPER_GROUP(p6mGroup, p6mOps);
+
+void p6mFunction::expand(FunctionPlan &plan) const
+{
+    LATTICE_BASIS(plan, Xhex6, Yhex6);
+    expandOrbits(plan, p6mGroup);
+}
+
 ////////////////////////////////////////////////////////////
 
 std::complex<double> pmFunction::bundle(double &x, double &y, unsigned int &i) const
 {
-    int N,M;
-    N = freqs[i].N();
-    M = freqs[i].M();
+    return term(x, y, freqs[i].N(), freqs[i].M());
+}
+
+std::complex<double> pmFunction::term(double x, double y, int N, int M) const
+{
     std::complex<double> part1 = (ei(N*Xrect + M*Yrect)+ei(-N*Xrect + M*Yrect))/2.0;
     
     return part1;
 }
 
-std::complex<double> pmFunction::operator ()(double i, double j)
+std::complex<double> pmFunction::evaluate(const FunctionPlan &plan, double i, double j) const
 {
-    std::complex<double> ans(0,0);
-    for(unsigned int k=0; k<terms; k++)
-    {
-        std::complex<double> thisterm = bundle(i, j, k);
-        thisterm *= coeffs[k].combined();
-        ans+= thisterm;
-    }
+    if (plan.lattice)
+        return evaluateLattice(plan, i, j);
     
-    ans *= scale.combined();
+    std::complex<double> ans(0,0);
+    for(int k = 0; k < plan.terms.size(); k++)
+        ans += plan.terms[k].coeff * term(i, j, plan.terms[k].n, plan.terms[k].m);
+
     return ans;
 }
 
+static const OrbitOp pmOps[] = {
+    { 1, 0, 0, 1, 1.0/2, NO_SIGN },
+    { -1, 0, 0, 1, 1.0/2, NO_SIGN }
+};
+WALLPAPER_GROUP(pmGroup, pmOps);
+
+void pmFunction::expand(FunctionPlan &plan) const
+{
+    LATTICE_BASIS(plan, Xrect, Yrect);
+    expandOrbits(plan, pmGroup);
+}
+
 ////////////////////////////////////////////////////////////
 
 std::complex<double> pmmFunction::bundle(double &x, double &y, unsigned int &i) const
 {
-    int N,M;
-    N = freqs[i].N();
-    M = freqs[i].M();
+    return term(x, y, freqs[i].N(), freqs[i].M());
+}
+
+std::complex<double> pmmFunction::term(double x, double y, int N, int M) const
+{
     std::complex<double> part1 = (ei(N*Xrect + M*Yrect)+ei(-N*Xrect + M*Yrect))/4.0;
     std::complex<double> part2 = (ei(-N*Xrect - M*Yrect)+ei(N*Xrect - M*Yrect))/4.0;
     return part1+part2;
 }
 
-std::complex<double> pmmFunction::operator ()(double i, double j)
+std::complex<double> pmmFunction::evaluate(const FunctionPlan &plan, double i, double j) const
 {
-    std::complex<double> ans(0,0);
-    for(unsigned int k=0; k<terms; k++)
-    {
-        std::complex<double> thisterm = bundle(i, j, k);
-        thisterm *= coeffs[k].combined();
-        ans+= thisterm;
-    }
+    if (plan.lattice)
+        return evaluateLattice(plan, i, j);
     
-    ans *= scale.combined();
+    std::complex<double> ans(0,0);
+    for(int k = 0; k < plan.terms.size(); k++)
+        ans += plan.terms[k].coeff * term(i, j, plan.terms[k].n, plan.terms[k].m);
+
     return ans;
 }
 
+static const OrbitOp pmmOps[] = {
+    { 1, 0, 0, 1, 1.0/4, NO_SIGN },
+    { -1, 0, 0, 1, 1.0/4, NO_SIGN },
+    { -1, 0, 0, -1, 1.0/4, NO_SIGN },
+    { 1, 0, 0, -1, 1.0/4, NO_SIGN }
+};
+WALLPAPER_GROUP(pmmGroup, pmmOps);
+
+void pmmFunction::expand(FunctionPlan &plan) const
+{
+    LATTICE_BASIS(plan, Xrect, Yrect);
+    expandOrbits(plan, pmmGroup);
+}
+
 ////////////////////////////////////////////////////////////
 
 std::complex<double> pggFunction::bundle(double &x, double &y, unsigned int &i) const
 {
-    int N,M, nega;
-    N = freqs[i].N();
-    M = freqs[i].M();
+    return term(x, y, freqs[i].N(), freqs[i].M());
+}
+
+std::complex<double> pggFunction::term(double x, double y, int N, int M) const
+{
+    int nega;
     nega = -1;
     if((N+M) % 2==0){nega=1;};
     std::complex<double> part1 = (ei(N*Xrect + M*Yrect)+ei(-N*Xrect -M*Yrect))/4.0;
@@ -413,27 +845,42 @@ std::complex<double> pggFunction::bundle(double &x, double &y, unsigned int &i)
     return part1+part2;
 }
 
-std::complex<double> pggFunction::operator ()(double i, double j)
+std::complex<double> pggFunction::evaluate(const FunctionPlan &plan, double i, double j) const
 {
-    std::complex<double> ans(0,0);
-    for(unsigned int k=0; k<terms; k++)
-    {
-        std::complex<double> thisterm = bundle(i, j, k);
-        thisterm *= coeffs[k].combined();
-        ans+= thisterm;
-    }
+    if (plan.lattice)
+        return evaluateLattice(plan, i, j);
     
-    ans *= scale.combined();
+    std::complex<double> ans(0,0);
+    for(int k = 0; k < plan.terms.size(); k++)
+        ans += plan.terms[k].coeff * term(i, j, plan.terms[k].n, plan.terms[k].m);
+
     return ans;
 }
 
+static const OrbitOp pggOps[] = {
+    { 1, 0, 0, 1, 1.0/4, NO_SIGN },
+    { -1, 0, 0, -1, 1.0/4, NO_SIGN },
+    { -1, 0, 0, 1, 1.0/4, NM_PARITY_SIGN },
+    { 1, 0, 0, -1, 1.0/4, NM_PARITY_SIGN }
+};
+WALLPAPER_GROUP(pggGroup, pggOps);
+
+void pggFunction::expand(FunctionPlan &plan) const
+{
+    LATTICE_BASIS(plan, Xrect, Yrect);
+    expandOrbits(plan, pggGroup);
+}
+
 ////////////////////////////////////////////////////////////
 
 std::complex<double> pmgFunction::bundle(double &x, double &y, unsigned int &i) const
 {
-    int N,M, nega;
-    N = freqs[i].N();
-    M = freqs[i].M();
+    return term(x, y, freqs[i].N(), freqs[i].M());
+}
+
+std::complex<double> pmgFunction::term(double x, double y, int N, int M) const
+{
+    int nega;
     nega = -1;
     if((M) % 2==0){nega=1;};
     std::complex<double> part1 = (ei(N*Xrect + M*Yrect)+ei(-N*Xrect -M*Yrect))/4.0;
@@ -442,54 +889,82 @@ std::complex<double> pmgFunction::bundle(double &x, double &y, unsigned int &i)
     return part1+part2;
 }
 
-std::complex<double> pmgFunction::operator ()(double i, double j)
+std::complex<double> pmgFunction::evaluate(const FunctionPlan &plan, double i, double j) const
 {
-    std::complex<double> ans(0,0);
-    for(unsigned int k=0; k<terms; k++)
-    {
-        std::complex<double> thisterm = bundle(i, j, k);
-        thisterm *= coeffs[k].combined();
-        ans+= thisterm;
-    }
+    if (plan.lattice)
+        return evaluateLattice(plan, i, j);
     
-    ans *= scale.combined();
+    std::complex<double> ans(0,0);
+    for(int k = 0; k < plan.terms.size(); k++)
+        ans += plan.terms[k].coeff * term(i, j, plan.terms[k].n, plan.terms[k].m);
+
     return ans;
 }
 
+static const OrbitOp pmgOps[] = {
+    { 1, 0, 0, 1, 1.0/4, NO_SIGN },
+    { -1, 0, 0, -1, 1.0/4, NO_SIGN },
+    { -1, 0, 0, 1, 1.0/4, M_PARITY_SIGN },
+    { 1, 0, 0, -1, 1.0/4, M_PARITY_SIGN }
+};
+WALLPAPER_GROUP(pmgGroup, pmgOps);
+
+void pmgFunction::expand(FunctionPlan &plan) const
+{
+    LATTICE_BASIS(plan, Xrect, Yrect);
+    expandOrbits(plan, pmgGroup);
+}
+
 ////////////////////////////////////////////////////////////
 
 std::complex<double> pgFunction::bundle(double &x, double &y, unsigned int &i) const
 {
-    int N,M, parity;
-    N = freqs[i].N();
-    M = freqs[i].M();
+    return term(x, y, freqs[i].N(), freqs[i].M());
+}
+
+std::complex<double> pgFunction::term(double x, double y, int N, int M) const
+{
+    int parity;
     parity = M%2;
     std::complex<double> part1 = (ei(N*Xrect + M*Yrect)+pow(-1,parity)*ei(-N*Xrect + M*Yrect))/2.0;
     
     return part1;
 }
 
-std::complex<double> pgFunction::operator ()(double i, double j)
+std::complex<double> pgFunction::evaluate(const FunctionPlan &plan, double i, double j) const
 {
-    std::complex<double> ans(0,0);
-    for(unsigned int k=0; k<terms; k++)
-    {
-        std::complex<double> thisterm = bundle(i, j, k);
-        thisterm *= coeffs[k].combined();
-        ans+= thisterm;
-    }
+    if (plan.lattice)
+        return evaluateLattice(plan, i, j);
     
-    ans *= scale.combined();
+    std::complex<double> ans(0,0);
+    for(int k = 0; k < plan.terms.size(); k++)
+        ans += plan.terms[k].coeff * term(i, j, plan.terms[k].n, plan.terms[k].m);
+
     return ans;
 }
 
+static const OrbitOp pgOps[] = {
+    { 1, 0, 0, 1, 1.0/2, NO_SIGN },
+    { -1, 0, 0, 1, 1.0/2, M_PARITY_SIGN }
+};
+WALLPAPER_GROUP(pgGroup, pgOps);
+
+void pgFunction::expand(FunctionPlan &plan) const
+{
+    LATTICE_BASIS(plan, Xrect, Yrect);
+    expandOrbits(plan, pgGroup);
+}
+
 ////////////////////////////////////////////////////////////
 
 std::complex<double> pmgpgFunction::bundle(double &x, double &y, unsigned int &i) const
 {
-    int N,M,nega;
-    N = freqs[i].N();
-    M = freqs[i].M();
+    return term(x, y, freqs[i].N(), freqs[i].M());
+}
+
+std::complex<double> pmgpgFunction::term(double x, double y, int N, int M) const
+{
+    int nega;
     nega = -1;
     if(M % 2==0){nega=1;};
     std::complex<double> part1 = ei(N*Xrect + M*Yrect);
@@ -501,55 +976,81 @@ std::complex<double> pmgpgFunction::bundle(double &x, double &y, unsigned int &i
     return (part1-part2+ (part3)-(part4))/ 4.0;
 }
 //Note: as a hack, I made part2 and part4 positive to create a pmg fcn.Changed back9/9/13
-std::complex<double> pmgpgFunction::operator ()(double i, double j)
+std::complex<double> pmgpgFunction::evaluate(const FunctionPlan &plan, double i, double j) const
 {
-    std::complex<double> ans(0,0);
-    for(unsigned int k=0; k<terms; k++)
-    {
-        std::complex<double> thisterm = bundle(i, j, k);
-        thisterm *= coeffs[k].combined();
-        ans+= thisterm;
-    }
+    if (plan.lattice)
+        return evaluateLattice(plan, i, j);
     
-    ans *= scale.combined();
+    std::complex<double> ans(0,0);
+    for(int k = 0; k < plan.terms.size(); k++)
+        ans += plan.terms[k].coeff * term(i, j, plan.terms[k].n, plan.terms[k].m);
+
     return ans;
 }
 
+static const OrbitOp pmgpgOps[] = {
+    { 1, 0, 0, 1, 1.0/4, NO_SIGN },
+    { -1, 0, 0, -1, -1.0/4, NO_SIGN },
+    { -1, 0, 0, 1, 1.0/4, M_PARITY_SIGN },
+    { 1, 0, 0, -1, -1.0/4, M_PARITY_SIGN }
+};
+WALLPAPER_GROUP(pmgpgGroup, pmgpgOps);
+
+void pmgpgFunction::expand(FunctionPlan &plan) const
+{
+    LATTICE_BASIS(plan, Xrect, Yrect);
+    expandOrbits(plan, pmgpgGroup);
+}
+
 ////////////////////////////////////////////////////////////
 //Note: Original rhombic function had no mirrors turned on. This is now a cm function. And I've switched to vertical stripes
 
 std::complex<double> rhombicFunction::bundle(double &x, double &y, unsigned int &i) const
 {
-    int N,M;
-    N = freqs[i].N();
-    M = freqs[i].M();
+    return term(x, y, freqs[i].N(), freqs[i].M());
+}
+
+std::complex<double> rhombicFunction::term(double x, double y, int N, int M) const
+{
     std::complex<double> part1 = ei(N*Xrhombic + M*Yrhombic);
     std::complex<double> part2 = ei(M*Xrhombic + N*Yrhombic);
     return (part1+part2)/2.0;
     
 }
 
-std::complex<double> rhombicFunction::operator ()(double i, double j)
+std::complex<double> rhombicFunction::evaluate(const FunctionPlan &plan, double i, double j) const
 {
-    std::complex<double> ans(0,0);
-    for(unsigned int k=0; k<terms; k++)
-    {
-        std::complex<double> thisterm = bundle(i, j, k);
-        thisterm *= coeffs[k].combined();
-        ans+= thisterm;
-    }
+    if (plan.lattice)
+        return evaluateLattice(plan, i, j);
     
-    ans *= scale.combined();
+    std::complex<double> ans(0,0);
+    for(int k = 0; k < plan.terms.size(); k++)
+        ans += plan.terms[k].coeff * term(i, j, plan.terms[k].n, plan.terms[k].m);
+
     return ans;
 }
 
+static const OrbitOp rhombicOps[] = {
+    { 1, 0, 0, 1, 1.0/2, NO_SIGN },
+    { 0, 1, 1, 0, 1.0/2, NO_SIGN }
+};
+WALLPAPER_GROUP(rhombicGroup, rhombicOps);
+
+void rhombicFunction::expand(FunctionPlan &plan) const
+{
+    LATTICE_BASIS(plan, Xrhombic, Yrhombic);
+    expandOrbits(plan, rhombicGroup);
+}
+
 ////////////////////////////////////////////////////////////
 
 std::complex<double> cmmFunction::bundle(double &x, double &y, unsigned int &i) const
 {
-    int N,M;
-    N = freqs[i].N();
-    M = freqs[i].M();
+    return term(x, y, freqs[i].N(), freqs[i].M());
+}
+
+std::complex<double> cmmFunction::term(double x, double y, int N, int M) const
+{
     std::complex<double> part1 = ei(N*Xrhombic2 + M*Yrhombic2)+ei(M*Xrhombic2 + N*Yrhombic2);
     std::complex<double> part2 = ei(-N*Xrhombic2 - M*Yrhombic2)+ei(-M*Xrhombic2 - N*Yrhombic2);
     
@@ -557,26 +1058,40 @@ std::complex<double> cmmFunction::bundle(double &x, double &y, unsigned int &i)
     
 }
 
-std::complex<double> cmmFunction::operator ()(double i, double j)
+std::complex<double> cmmFunction::evaluate(const FunctionPlan &plan, double i, double j) const
 {
-    std::complex<double> ans(0,0);
-    for(unsigned int k=0; k<terms; k++)
-    {
-        std::complex<double> thisterm = bundle(i, j, k);
-        thisterm *= coeffs[k].combined();
-        ans+= thisterm;
-    }
+    if (plan.lattice)
+        return evaluateLattice(plan, i, j);
     
-    ans *= scale.combined();
+    std::complex<double> ans(0,0);
+    for(int k = 0; k < plan.terms.size(); k++)
+        ans += plan.terms[k].coeff * term(i, j, plan.terms[k].n, plan.terms[k].m);
+
     return ans;
 }
+
+static const OrbitOp cmmOps[] = {
+    { 1, 0, 0, 1, 1.0/4, NO_SIGN },
+    { 0, 1, 1, 0, 1.0/4, NO_SIGN },
+    { -1, 0, 0, -1, 1.0/4, NO_SIGN },
+    { 0, -1, -1, 0, 1.0/4, NO_SIGN }
+};
+WALLPAPER_GROUP(cmmGroup, cmmOps);
+
+void cmmFunction::expand(FunctionPlan &plan) const
+{
+    LATTICE_BASIS(plan, Xrhombic2, Yrhombic2);
+    expandOrbits(plan, cmmGroup);
+}
 ////////////////////////////////////////////////////////////
 
 std::complex<double> squareFunction::bundle(double &x, double &y, unsigned int &i) const
 {
-    int N,M;
-    N = freqs[i].N();
-    M = freqs[i].M();
+    return term(x, y, freqs[i].N(), freqs[i].M());
+}
+
+std::complex<double> squareFunction::term(double x, double y, int N, int M) const
+{
     std::complex<double> part1 = ei(N*Xsquare + M*Ysquare);
     std::complex<double> part2 = ei(-M*Xsquare + N*Ysquare);
     std::complex<double> part3 = ei(-N*Xsquare - M*Ysquare);
@@ -587,26 +1102,40 @@ std::complex<double> squareFunction::bundle(double &x, double &y, unsigned int &
     
 }
 
-std::complex<double> squareFunction::operator ()(double i, double j)
+std::complex<double> squareFunction::evaluate(const FunctionPlan &plan, double i, double j) const
 {
-    std::complex<double> ans(0,0);
-    for(unsigned int k=0; k<terms; k++)
-    {
-        std::complex<double> thisterm = bundle(i, j, k);
-        thisterm *= coeffs[k].combined();
-        ans+= thisterm;
-    }
+    if (plan.lattice)
+        return evaluateLattice(plan, i, j);
     
-    ans *= scale.combined();
+    std::complex<double> ans(0,0);
+    for(int k = 0; k < plan.terms.size(); k++)
+        ans += plan.terms[k].coeff * term(i, j, plan.terms[k].n, plan.terms[k].m);
+
     return ans;
 }
+
+static const OrbitOp squareOps[] = {
+    { 1, 0, 0, 1, 1.0/4, NO_SIGN },
+    { 0, -1, 1, 0, 1.0/4, NO_SIGN },
+    { -1, 0, 0, -1, 1.0/4, NO_SIGN },
+    { 0, 1, -1, 0, 1.0/4, NO_SIGN }
+};
+WALLPAPER_GROUP(squareGroup, squareOps);
+
+void squareFunction::expand(FunctionPlan &plan) const
+{
+    LATTICE_BASIS(plan, Xsquare, Ysquare);
+    expandOrbits(plan, squareGroup);
+}
 ////////////////////////////////////////////////////////////
 
 std::complex<double> p4mFunction::bundle(double &x, double &y, unsigned int &i) const
 {
-    int N,M;
-    N = freqs[i].N();
-    M = freqs[i].M();
+    return term(x, y, freqs[i].N(), freqs[i].M());
+}
+
+std::complex<double> p4mFunction::term(double x, double y, int N, int M) const
+{
     std::complex<double> part1 = ei(N*Xsquare + M*Ysquare);
     std::complex<double> part2 = ei(-M*Xsquare + N*Ysquare);
     std::complex<double> part3 = ei(-N*Xsquare - M*Ysquare);
@@ -620,27 +1149,45 @@ std::complex<double> p4mFunction::bundle(double &x, double &y, unsigned int &i)
     
 }
 
-std::complex<double>  p4mFunction::operator ()(double i, double j)
+std::complex<double> p4mFunction::evaluate(const FunctionPlan &plan, double i, double j) const
 {
-    std::complex<double> ans(0,0);
-    for(unsigned int k=0; k<terms; k++)
-    {
-        std::complex<double> thisterm = bundle(i, j, k);
-        thisterm *= coeffs[k].combined();
-        ans+= thisterm;
-    }
+    if (plan.lattice)
+        return evaluateLattice(plan, i, j);
     
-    ans *= scale.combined();
+    std::complex<double> ans(0,0);
+    for(int k = 0; k < plan.terms.size(); k++)
+        ans += plan.terms[k].coeff * term(i, j, plan.terms[k].n, plan.terms[k].m);
+
     return ans;
 }
 
+static const OrbitOp p4mOps[] = {
+    { 1, 0, 0, 1, 1.0/4, NO_SIGN },
+    { 0, -1, 1, 0, 1.0/4, NO_SIGN },
+    { -1, 0, 0, -1, 1.0/4, NO_SIGN },
+    { 0, 1, -1, 0, 1.0/4, NO_SIGN },
+    { 0, 1, 1, 0, 1.0/4, NO_SIGN },
+    { -1, 0, 0, 1, 1.0/4, NO_SIGN },
+    { 0, -1, -1, 0, 1.0/4, NO_SIGN },
+    { 1, 0, 0, -1, 1.0/4, NO_SIGN }
+};
+WALLPAPER_GROUP(p4mGroup, p4mOps);
+
+void p4mFunction::expand(FunctionPlan &plan) const
+{
+    LATTICE_BASIS(plan, Xsquare, Ysquare);
+    expandOrbits(plan, p4mGroup);
+}
+
 ////////////////////////////////////////////////////////////
 
 std::complex<double> p4gFunction::bundle(double &x, double &y, unsigned int &i) const
 {
-    int N,M;
-    N = freqs[i].N();
-    M = freqs[i].M();
+    return term(x, y, freqs[i].N(), freqs[i].M());
+}
+
+std::complex<double> p4gFunction::term(double x, double y, int N, int M) const
+{
     double G=pow(-1.0,N+M);
     std::complex<double> part1 = ei(N*Xsquare + M*Ysquare);
     std::complex<double> part2 = ei(-M*Xsquare + N*Ysquare);
@@ -655,27 +1202,45 @@ std::complex<double> p4gFunction::bundle(double &x, double &y, unsigned int &i)
     
 }
 
-std::complex<double>  p4gFunction::operator ()(double i, double j)
+std::complex<double> p4gFunction::evaluate(const FunctionPlan &plan, double i, double j) const
 {
-    std::complex<double> ans(0,0);
-    for(unsigned int k=0; k<terms; k++)
-    {
-        std::complex<double> thisterm = bundle(i, j, k);
-        thisterm *= coeffs[k].combined();
-        ans+= thisterm;
-    }
+    if (plan.lattice)
+        return evaluateLattice(plan, i, j);
     
-    ans *= scale.combined();
+    std::complex<double> ans(0,0);
+    for(int k = 0; k < plan.terms.size(); k++)
+        ans += plan.terms[k].coeff * term(i, j, plan.terms[k].n, plan.terms[k].m);
+
     return ans;
 }
 
+static const OrbitOp p4gOps[] = {
+    { 1, 0, 0, 1, 1.0/4, NO_SIGN },
+    { 0, -1, 1, 0, 1.0/4, NO_SIGN },
+    { -1, 0, 0, -1, 1.0/4, NO_SIGN },
+    { 0, 1, -1, 0, 1.0/4, NO_SIGN },
+    { 0, 1, 1, 0, 1.0/4, NM_PARITY_SIGN },
+    { -1, 0, 0, 1, 1.0/4, NM_PARITY_SIGN },
+    { 0, -1, -1, 0, 1.0/4, NM_PARITY_SIGN },
+    { 1, 0, 0, -1, 1.0/4, NM_PARITY_SIGN }
+};
+WALLPAPER_GROUP(p4gGroup, p4gOps);
+
+void p4gFunction::expand(FunctionPlan &plan) const
+{
+    LATTICE_BASIS(plan, Xsquare, Ysquare);
+    expandOrbits(plan, p4gGroup);
+}
+
 ////////////////////////////////////////////////////////////
 
 std::complex<double> zzbarFunction::bundle(double &x, double &y, unsigned int &i) const
 {
-    int N,M;
-    N = freqs[i].N();
-    M = freqs[i].M();
+    return term(x, y, freqs[i].N(), freqs[i].M());
+}
+
+std::complex<double> zzbarFunction::term(double x, double y, int N, int M) const
+{
     std::complex<double> ans(x , y);
     std::complex<double> ans2(x , y);
     ans=pow(ans,N);
@@ -684,16 +1249,15 @@ std::complex<double> zzbarFunction::bundle(double &x, double &y, unsigned int &i
     
 }
 
-std::complex<double> zzbarFunction::operator ()(double i, double j)
+std::complex<double> zzbarFunction::evaluate(const FunctionPlan &plan, double i, double j) const
 {
+    // z^N and conj(z)^M = conj(z^M) come off one ladder shared by all terms
+    PowerLadder z(std::complex<double>(i, j), plan.powerMin, plan.powerMax);
+    
     std::complex<double> ans(0,0);
-    for(unsigned int k=0; k<terms; k++)
-    {
-        std::complex<double> thisterm = bundle(i, j, k);
-        thisterm *= coeffs[k].combined();
-        ans+= thisterm;
-    }
-    ans *= scale.combined();
+    for(int k = 0; k < plan.terms.size(); k++)
+        ans += plan.terms[k].coeff * z[plan.terms[k].n] * conj(z[plan.terms[k].m]);
+
     return ans;
 }
 
@@ -11,6 +11,82 @@
 #include "geomath.h"
 #include "display.h"
 
+// attenuated terms of a draft render below this fraction of the largest
+// coefficient are dropped (see AbstractFunction::limitDetail)
+const double DETAIL_THRESHOLD = 1.0 / 256;
+
+// one term of a compiled function: its coefficient with the function's
+// global scale already multiplied in, plus its frequency pair
+struct PlanTerm
+{
+    std::complex<double> coeff;
+    int n;
+    int m;
+};
+
+struct WallpaperGroup;
+
+// flat, read-only snapshot of a function's terms. Built once per render job
+// by AbstractFunction::compile() so the per-pixel loop never touches the
+// coeffpair/freqpair vectors or recomputes coeffs[k].combined()
+//
+// For the lattice-based groups, expand() also writes the function out as a
+// plain Fourier sum on its lattice,
+//     f(x,y) = sum_j waves[j].coeff * ei(waves[j].n * X + waves[j].m * Y)
+// where X = Xx*x + Xy*y and Y = Yx*x + Yy*y are the group's lattice macros.
+// nMin..nMax and mMin..mMax span the wave frequencies and powerMin..powerMax
+// the terms' n and m (all of them always include 0)
+//
+// Every function is linear in its coefficients: f = sum_k terms[k].coeff * b_k,
+// where b_k is what compileTerm(k) evaluates to. compileTerms() stops short
+// of expand() and only lists the terms
+struct FunctionPlan
+{
+    QVector<PlanTerm> terms;
+    int powerMin = 0, powerMax = 0;
+    
+    bool lattice = false;
+    double Xx = 0.0, Xy = 0.0, Yx = 0.0, Yy = 0.0;
+    QVector<PlanTerm> waves;
+    int nMin = 0, nMax = 0, mMin = 0, mMax = 0;
+    const WallpaperGroup *group = 0;    // set by expandOrbits()
+};
+
+// one element of a wallpaper group's orbit sum. It sends a term's frequency
+// pair (N,M) to (a*N + b*M, c*N + d*M) with the given weight; sign can also
+// flip the weight by the parity of the term's N+M (p4g, pgg) or M (pg, pmg)
+struct OrbitOp
+{
+    int a, b, c, d;
+    double weight;
+    int sign;
+};
+
+const int NO_SIGN = 0;
+const int NM_PARITY_SIGN = 1;
+const int M_PARITY_SIGN = 2;
+
+// a wallpaper group's orbit as data; the lattice basis comes from the
+// group's X/Y macros (see LATTICE_BASIS)
+struct WallpaperGroup
+{
+    const OrbitOp *ops;
+    int count;
+};
+
+#define WALLPAPER_GROUP(name, ops) \
+    static const WallpaperGroup name = { ops, int(sizeof(ops) / sizeof(ops[0])) }
+
+// reads a pair of linear lattice macros (written in terms of x and y) off at
+// the unit vectors, giving the lattice basis of a FunctionPlan
+#define LATTICE_BASIS(plan, LX, LY) {                  \
+    double x = 1.0, y = 0.0;                            \
+    (plan).Xx = (LX); (plan).Yx = (LY);                 \
+    x = 0.0; y = 1.0;                                   \
+    (plan).Xy = (LX); (plan).Yy = (LY);                 \
+    (plan).lattice = true;                              \
+}
+
 class AbstractFunction      //this is the base class for all other classes that follow in this file;
 {                           //it defines many of the member functions that we needed for all of the
 public:                   //derived classes
@@ -24,7 +100,17 @@ public:                   //derived classes
     // CONST MEMBER FUNCTIONS
     int getNumTerms() { return terms; }
     virtual std::complex<double> bundle(double &x, double &y, unsigned int &i) const = 0;
-    virtual std::complex<double> operator() (double i, double j) = 0;
+    virtual std::complex<double> evaluate(const FunctionPlan &plan, double i, double j) const = 0;
+    std::complex<double> operator() (double i, double j) const { return evaluate(compile(), i, j); }
+    FunctionPlan compile() const;
+    FunctionPlan compileTerms() const;
+    FunctionPlan compileTerm(unsigned int k) const;
+    FunctionPlan compile(const FunctionPlan &terms) const;
+    int limitDetail(FunctionPlan &terms, double xPitch, double yPitch) const;
+    void evaluateBatch(const FunctionPlan &plan, const double *x, const double *y, int count, double *re, double *im) const;
+    void evaluateScanline(const FunctionPlan &plan, double x0, double y0, double dx, double dy, int count, double *re, double *im) const;
+    double scanlineError(double x0, double y0, double dx, double dy, int count) const;
+    double batchError(int kernel, const double *x, const double *y, int count) const;
     int getN(unsigned int &i) const;
     int getM(unsigned int &i) const;
     double getR(unsigned int &i) const;
@@ -56,6 +142,13 @@ protected:
     
     // PRIVATE MEMBER FUNCTIONS
     void initWithVectors(QVector<coeffpair> &in_coeffs, QVector<freqpair> &in_freqs);
+    virtual void expand(FunctionPlan & /* unused */) const { }
+    std::complex<double> evaluateLattice(const FunctionPlan &plan, double x, double y) const;
+    static void expandOrbits(FunctionPlan &plan, const WallpaperGroup &group);
+    
+    // how many radians a term's phase turns per unit of x and of y at most,
+    // for limitDetail(); 0 for functions without a lattice form
+    void termFrequencies(const PlanTerm &term, double *alongX, double *alongY) const;
 };
 
 
@@ -81,7 +174,9 @@ public:
     generalFunction(unsigned int in_terms) { terms = in_terms; refresh(); }
     generalFunction(QVector<coeffpair> in_coeffs, QVector<freqpair> in_freqs) {initWithVectors(in_coeffs, in_freqs);}
     std::complex<double> bundle(double &x, double &y, unsigned int &i) const;
-    std::complex<double> operator() (double i, double j);
+    std::complex<double> evaluate(const FunctionPlan &plan, double i, double j) const;
+    std::complex<double> term(double x, double y, int N, int M) const;
+    void expand(FunctionPlan &plan) const;
     
     virtual AbstractFunction* clone() const { return new generalFunction(*this); };
     
@@ -106,7 +201,9 @@ public:
     generalpairedFunction(QVector<coeffpair> in_coeffs, QVector<freqpair> in_freqs) {initWithVectors(in_coeffs, in_freqs);}
     
     std::complex<double> bundle(double &x, double &y, unsigned int &i) const;
-    std::complex<double> operator() (double i, double j);
+    std::complex<double> evaluate(const FunctionPlan &plan, double i, double j) const;
+    std::complex<double> term(double x, double y, int N, int M) const;
+    void expand(FunctionPlan &plan) const;
     
     virtual AbstractFunction* clone() const { return new generalpairedFunction(*this); };
 };
@@ -125,7 +222,9 @@ public:
     hex3Function(QVector<coeffpair> in_coeffs, QVector<freqpair> in_freqs) {initWithVectors(in_coeffs, in_freqs);}
     
     std::complex<double> bundle(double &x, double &y, unsigned int &i) const;
-    std::complex<double> operator() (double i, double j);
+    std::complex<double> evaluate(const FunctionPlan &plan, double i, double j) const;
+    std::complex<double> term(double x, double y, int N, int M) const;
+    void expand(FunctionPlan &plan) const;
     
     virtual AbstractFunction* clone() const { return new hex3Function(*this); };
     
@@ -143,7 +242,9 @@ public:
     p31mFunction(QVector<coeffpair> in_coeffs, QVector<freqpair> in_freqs) {initWithVectors(in_coeffs, in_freqs);}
     
     std::complex<double> bundle(double &x, double &y, unsigned int &i) const;
-    std::complex<double> operator() (double i, double j);
+    std::complex<double> evaluate(const FunctionPlan &plan, double i, double j) const;
+    std::complex<double> term(double x, double y, int N, int M) const;
+    void expand(FunctionPlan &plan) const;
     
     virtual AbstractFunction* clone() const { return new p31mFunction(*this); };
     
@@ -161,7 +262,9 @@ public:
     p3m1Function(QVector<coeffpair> in_coeffs, QVector<freqpair> in_freqs) {initWithVectors(in_coeffs, in_freqs);}
     
     std::complex<double> bundle(double &x, double &y, unsigned int &i) const;
-    std::complex<double> operator() (double i, double j);
+    std::complex<double> evaluate(const FunctionPlan &plan, double i, double j) const;
+    std::complex<double> term(double x, double y, int N, int M) const;
+    void expand(FunctionPlan &plan) const;
     
     virtual AbstractFunction* clone() const { return new p3m1Function(*this); };
     
@@ -180,7 +283,9 @@ public:
     hex6Function(QVector<coeffpair> in_coeffs, QVector<freqpair> in_freqs) {initWithVectors(in_coeffs, in_freqs);}
     
     std::complex<double> bundle(double &x, double &y, unsigned int &i) const;
-    std::complex<double> operator() (double i, double j);
+    std::complex<double> evaluate(const FunctionPlan &plan, double i, double j) const;
+    std::complex<double> term(double x, double y, int N, int M) const;
+    void expand(FunctionPlan &plan) const;
     
     virtual AbstractFunction* clone() const { return new hex6Function(*this); };
     
@@ -197,7 +302,9 @@ public:
     p6mFunction(QVector<coeffpair> in_coeffs, QVector<freqpair> in_freqs) {initWithVectors(in_coeffs, in_freqs);}
     
     std::complex<double> bundle(double &x, double &y, unsigned int &i) const;
-    std::complex<double> operator() (double i, double j);
+    std::complex<double> evaluate(const FunctionPlan &plan, double i, double j) const;
+    std::complex<double> term(double x, double y, int N, int M) const;
+    void expand(FunctionPlan &plan) const;
     
     virtual AbstractFunction* clone() const { return new p6mFunction(*this); };
     
@@ -221,7 +328,9 @@ public:
     pmFunction(QVector<coeffpair> in_coeffs, QVector<freqpair> in_freqs) {initWithVectors(in_coeffs, in_freqs);}
     
     std::complex<double> bundle(double &x, double &y, unsigned int &i) const;
-    std::complex<double> operator() (double i, double j);
+    std::complex<double> evaluate(const FunctionPlan &plan, double i, double j) const;
+    std::complex<double> term(double x, double y, int N, int M) const;
+    void expand(FunctionPlan &plan) const;
     
     virtual AbstractFunction* clone() const { return new pmFunction(*this); };
 };
@@ -234,7 +343,9 @@ public:
     pmmFunction(QVector<coeffpair> in_coeffs, QVector<freqpair> in_freqs) {initWithVectors(in_coeffs, in_freqs);}
     
     std::complex<double> bundle(double &x, double &y, unsigned int &i) const;
-    std::complex<double> operator() (double i, double j);
+    std::complex<double> evaluate(const FunctionPlan &plan, double i, double j) const;
+    std::complex<double> term(double x, double y, int N, int M) const;
+    void expand(FunctionPlan &plan) const;
     
     virtual AbstractFunction* clone() const { return new pmmFunction(*this); };
 };
@@ -248,7 +359,9 @@ public:
     pggFunction(QVector<coeffpair> in_coeffs, QVector<freqpair> in_freqs) {initWithVectors(in_coeffs, in_freqs);}
     
     std::complex<double> bundle(double &x, double &y, unsigned int &i) const;
-    std::complex<double> operator() (double i, double j);
+    std::complex<double> evaluate(const FunctionPlan &plan, double i, double j) const;
+    std::complex<double> term(double x, double y, int N, int M) const;
+    void expand(FunctionPlan &plan) const;
     
     virtual AbstractFunction* clone() const { return new pggFunction(*this); };
 };
@@ -261,7 +374,9 @@ public:
     pmgFunction(QVector<coeffpair> in_coeffs, QVector<freqpair> in_freqs) {initWithVectors(in_coeffs, in_freqs);}
     
     std::complex<double> bundle(double &x, double &y, unsigned int &i) const;
-    std::complex<double> operator() (double i, double j);
+    std::complex<double> evaluate(const FunctionPlan &plan, double i, double j) const;
+    std::complex<double> term(double x, double y, int N, int M) const;
+    void expand(FunctionPlan &plan) const;
     
     virtual AbstractFunction* clone() const { return new pmgFunction(*this); };
 };
@@ -274,7 +389,9 @@ public:
     pgFunction(QVector<coeffpair> in_coeffs, QVector<freqpair> in_freqs) {initWithVectors(in_coeffs, in_freqs);}
     
     std::complex<double> bundle(double &x, double &y, unsigned int &i) const;
-    std::complex<double> operator() (double i, double j);
+    std::complex<double> evaluate(const FunctionPlan &plan, double i, double j) const;
+    std::complex<double> term(double x, double y, int N, int M) const;
+    void expand(FunctionPlan &plan) const;
     
     virtual AbstractFunction* clone() const { return new pgFunction(*this); };
 };
@@ -287,7 +404,9 @@ public:
     pmgpgFunction(QVector<coeffpair> in_coeffs, QVector<freqpair> in_freqs) {initWithVectors(in_coeffs, in_freqs);}
     
     std::complex<double> bundle(double &x, double &y, unsigned int &i) const;
-    std::complex<double> operator() (double i, double j);
+    std::complex<double> evaluate(const FunctionPlan &plan, double i, double j) const;
+    std::complex<double> term(double x, double y, int N, int M) const;
+    void expand(FunctionPlan &plan) const;
     
     virtual AbstractFunction* clone() const { return new pmgpgFunction(*this); };
 };
@@ -316,7 +435,9 @@ public:
     rhombicFunction(QVector<coeffpair> in_coeffs, QVector<freqpair> in_freqs) {initWithVectors(in_coeffs, in_freqs);}
     
     std::complex<double> bundle(double &x, double &y, unsigned int &i) const;
-    std::complex<double> operator() (double i, double j);
+    std::complex<double> evaluate(const FunctionPlan &plan, double i, double j) const;
+    std::complex<double> term(double x, double y, int N, int M) const;
+    void expand(FunctionPlan &plan) const;
     
     virtual AbstractFunction* clone() const { return new rhombicFunction(*this); };
     
@@ -340,7 +461,9 @@ public:
     cmmFunction(QVector<coeffpair> in_coeffs, QVector<freqpair> in_freqs) {initWithVectors(in_coeffs, in_freqs);}
     
     std::complex<double> bundle(double &x, double &y, unsigned int &i) const;
-    std::complex<double> operator() (double i, double j);
+    std::complex<double> evaluate(const FunctionPlan &plan, double i, double j) const;
+    std::complex<double> term(double x, double y, int N, int M) const;
+    void expand(FunctionPlan &plan) const;
     
     virtual AbstractFunction* clone() const { return new cmmFunction(*this); };
     
@@ -359,7 +482,9 @@ public:
     squareFunction(QVector<coeffpair> in_coeffs, QVector<freqpair> in_freqs) {initWithVectors(in_coeffs, in_freqs);}
     
     std::complex<double> bundle(double &x, double &y, unsigned int &i) const;
-    std::complex<double> operator() (double i, double j);
+    std::complex<double> evaluate(const FunctionPlan &plan, double i, double j) const;
+    std::complex<double> term(double x, double y, int N, int M) const;
+    void expand(FunctionPlan &plan) const;
     
     virtual AbstractFunction* clone() const { return new squareFunction(*this); };
     
@@ -375,7 +500,9 @@ public:
     p4mFunction(QVector<coeffpair> in_coeffs, QVector<freqpair> in_freqs) {initWithVectors(in_coeffs, in_freqs);}
     
     std::complex<double> bundle(double &x, double &y, unsigned int &i) const;
-    std::complex<double> operator() (double i, double j);
+    std::complex<double> evaluate(const FunctionPlan &plan, double i, double j) const;
+    std::complex<double> term(double x, double y, int N, int M) const;
+    void expand(FunctionPlan &plan) const;
     
     virtual AbstractFunction* clone() const { return new p4mFunction(*this); };
     
@@ -391,7 +518,9 @@ public:
     p4gFunction(QVector<coeffpair> in_coeffs, QVector<freqpair> in_freqs) {initWithVectors(in_coeffs, in_freqs);}
     
     std::complex<double> bundle(double &x, double &y, unsigned int &i) const;
-    std::complex<double> operator() (double i, double j);
+    std::complex<double> evaluate(const FunctionPlan &plan, double i, double j) const;
+    std::complex<double> term(double x, double y, int N, int M) const;
+    void expand(FunctionPlan &plan) const;
     
     virtual AbstractFunction* clone() const { return new p4gFunction(*this); };
     
@@ -408,7 +537,8 @@ public:
     zzbarFunction(QVector<coeffpair> in_coeffs, QVector<freqpair> in_freqs) {initWithVectors(in_coeffs, in_freqs);}
     
     std::complex<double> bundle(double &x, double &y, unsigned int &i) const;
-    std::complex<double> operator() (double i, double j);
+    std::complex<double> evaluate(const FunctionPlan &plan, double i, double j) const;
+    std::complex<double> term(double x, double y, int N, int M) const;
     
     virtual AbstractFunction* clone() const { return new zzbarFunction(*this); };
     
@@ -18,6 +18,11 @@ Interface::Interface(QWidget *parent) : QWidget(parent)
     termIndex = 0;
     saveloadPath = QDir::homePath();
     errPrint = false;
+    lastPreviewRequest = -1;
+    previewStarted = 0;
+    previewStep = 1;
+    previewInFlight = false;
+    previewClock.start();
 
     // FUNCTIONAL OBJECTS
     functionVector.push_back(new hex3Function());
@@ -192,10 +197,24 @@ void Interface::initPreviewDisplay()
     displayProgressBar->setPermanentVisibility(false);
     exportProgressBar->setPermanentVisibility(true);
     
+    skippedTermsLabel = new QLabel(displayWidget);
+    skippedTermsLabel->setAlignment(Qt::AlignCenter);
+    skippedTermsLabel->setVisible(false);
+    
+    periodGridLabel = new QLabel(tr("The period grid is too coarse for this function; the preview is evaluated exactly"), displayWidget);
+    periodGridLabel->setAlignment(Qt::AlignCenter);
+    periodGridLabel->setVisible(false);
+    
+    previewSettleTimer = new QTimer(this);
+    previewSettleTimer->setSingleShot(true);
+    previewSettleTimer->setInterval(PREVIEW_SETTLE_INTERVAL);
+    
     dispLayout->setAlignment(disp, Qt::AlignCenter);
     dispLayout->addWidget(disp);
     dispLayout->addLayout(displayProgressBar->layout);
     dispLayout->addLayout(buttonLayout);
+    dispLayout->addWidget(skippedTermsLabel);
+    dispLayout->addWidget(periodGridLabel);
     dispLayout->addStretch();
 }
 
@@ -640,6 +659,8 @@ void Interface::initImageProps()
     imageStretchXLayout = new QHBoxLayout();
     imageStretchYLayout = new QHBoxLayout();
     aspectRatioLayout = new QHBoxLayout();
+    evaluationLayout = new QHBoxLayout();
+    basisBudgetLayout = new QHBoxLayout();
     
     worldWidthLabel = new QLabel(tr("Horizontal Scaling"), imagePropsBox);
     worldHeightLabel = new QLabel(tr("Vertical Scaling"), imagePropsBox);
@@ -648,6 +669,10 @@ void Interface::initImageProps()
     worldWidthEditSlider = new QDoubleSlider(imagePropsBox);
     worldHeightEditSlider = new QDoubleSlider(imagePropsBox);
     worldAspectRatioCheckBox = new QCheckBox(imagePropsBox);
+    evaluationLabel = new QLabel(tr("Evaluation"), imagePropsBox);
+    evaluationSel = new QComboBox(imagePropsBox);
+    basisBudgetLabel = new QLabel(tr("Preview Cache (MB)"), imagePropsBox);
+    basisBudgetSpinBox = new QSpinBox(imagePropsBox);
     worldWidthEdit = new CustomLineEdit(imagePropsBox);
     worldHeightEdit = new CustomLineEdit(imagePropsBox);
     worldWidthEdit->setValidator(doubleValidate);
@@ -668,6 +693,30 @@ void Interface::initImageProps()
     aspectRatioLayout->addWidget(scalingAspectRatioLabel);
     aspectRatioLayout->addWidget(worldAspectRatioCheckBox);
     
+    // every mode renders the same pattern; they differ in speed, and the
+    // resampling ones fall back to exact tables when over FFT_ERROR_TOLERANCE
+    evaluationSel->setFocusPolicy(Qt::StrongFocus);
+    evaluationSel->addItem(tr("Direct"), DIRECT_EVALUATION);
+    evaluationSel->addItem(tr("Batch"), BATCH_EVALUATION);
+    evaluationSel->addItem(tr("Recurrence"), RECURRENCE_EVALUATION);
+    evaluationSel->addItem(tr("Separable"), SEPARABLE_EVALUATION);
+    evaluationSel->addItem(tr("FFT Period"), FFT_EVALUATION);
+    evaluationSel->addItem(tr("Fundamental Domain"), DOMAIN_EVALUATION);
+    evaluationSel->setCurrentIndex(evaluationSel->findData(settings->EvaluationMode));
+    
+    evaluationLayout->addWidget(evaluationLabel);
+    evaluationLayout->addWidget(evaluationSel);
+    
+    // the memory the preview may spend on per-term basis planes, which make
+    // coefficient edits re-sum instead of re-evaluate; 0 turns them off
+    basisBudgetSpinBox->setFocusPolicy(Qt::StrongFocus);
+    basisBudgetSpinBox->setRange(0, MAX_BASIS_CACHE_BUDGET);
+    basisBudgetSpinBox->setSingleStep(64);
+    basisBudgetSpinBox->setValue(settings->BasisCacheBudget);
+    
+    basisBudgetLayout->addWidget(basisBudgetLabel);
+    basisBudgetLayout->addWidget(basisBudgetSpinBox);
+    
     XShiftEditSlider->setFixedWidth(100);
     YShiftEditSlider->setFixedWidth(100);
     XShiftEditSlider->setRange(-1000, 1000);
@@ -701,6 +750,8 @@ void Interface::initImageProps()
     imagePropsBoxLayout->addLayout(imageStretchXLayout);
     imagePropsBoxLayout->addLayout(imageStretchYLayout);
     imagePropsBoxLayout->addLayout(aspectRatioLayout);
+    imagePropsBoxLayout->addLayout(evaluationLayout);
+    imagePropsBoxLayout->addLayout(basisBudgetLayout);
     
     
 }
@@ -852,6 +903,8 @@ void Interface::connectAllSignals()
     connect(worldWidthEdit, SIGNAL(returnPressed()), this, SLOT(changeWorldWidth()));
     connect(worldHeightEdit, SIGNAL(returnPressed()), this, SLOT(changeWorldHeight()));
     connect(worldAspectRatioCheckBox, SIGNAL(clicked(bool)), this, SLOT(aspectRatioLocked(bool)));
+    connect(evaluationSel, SIGNAL(currentIndexChanged(int)), this, SLOT(changeEvaluationMode(int)));
+    connect(basisBudgetSpinBox, SIGNAL(valueChanged(int)), this, SLOT(changeBasisCacheBudget(int)));
     connect(XShiftEditSlider, SIGNAL(doubleValueChanged(double)), this, SLOT(changeXCorner(double)));
     connect(XShiftEditSlider, SIGNAL(newSliderAction(QObject*, double, double)), this, SLOT(createUndoAction(QObject*, double, double)));
     connect(YShiftEditSlider, SIGNAL(doubleValueChanged(double)), this, SLOT(changeYCorner(double)));
@@ -873,11 +926,15 @@ void Interface::connectAllSignals()
     
     connect(previewDisplayPort->getControllerObject(), SIGNAL(partialProgressChanged(double)), displayProgressBar, SLOT(partialUpdate(double)));
     connect(previewDisplayPort, SIGNAL(paintingFinished(bool)), this, SLOT(resetMainWindowButton(bool)));
+    connect(previewDisplayPort, SIGNAL(paintingFinished(bool)), this, SLOT(recordPreviewFrame()));
+    connect(previewSettleTimer, SIGNAL(timeout()), this, SLOT(settlePreview()));
     connect(displayProgressBar, SIGNAL(renderFinished()), this, SLOT(resetTableButton()));
     connect(imageExportPort, SIGNAL(finishedExport(QString)), this, SLOT(popUpImageExportFinished(QString)));
     connect(imageExportPort->getControllerObject(), SIGNAL(partialProgressChanged(double)), exportProgressBar, SLOT(partialUpdate(double)));
     qRegisterMetaType<ComplexValue>("ComplexValue");
     connect(previewDisplayPort->getControllerObject(), SIGNAL(newImageDataPoint(ComplexValue)), this, SLOT(addNewImageDataPoint(ComplexValue)));
+    connect(previewDisplayPort->getControllerObject(), SIGNAL(termsSkipped(int)), this, SLOT(updateSkippedTerms(int)));
+    connect(previewDisplayPort->getControllerObject(), SIGNAL(periodGridRejected(bool)), periodGridLabel, SLOT(setVisible(bool)));
     
     //shortcut
     connect(updatePreviewShortcut, SIGNAL(activated()), this, SLOT(snapshotFunction()));
@@ -1644,19 +1701,69 @@ void Interface::updatePreviewDisplay()
     if (!newUpdate) {
         return;
     }
-
-   // qDebug() << "updates";
     
+    // edits that come in less than PREVIEW_SETTLE_INTERVAL apart are one
+    // interaction (dragging, scrubbing, panning); its frames are drawn only
+    // as fine as fits in the frame budget, and a full-quality one follows
+    // once it stops
+    qint64 now = previewClock.elapsed();
+    bool interacting = lastPreviewRequest >= 0 && now - lastPreviewRequest < PREVIEW_SETTLE_INTERVAL;
+    lastPreviewRequest = now;
+    
+    if (!interacting) {
+        renderPreview(1);
+        return;
+    }
+    
+    FrameGovernor::Combination combination(functionSel->currentIndex(), colorwheelSel->currentIndex());
+    int pixels = disp->getWidth() * disp->getHeight();
+    
+    // the frame this one supersedes ran for at least this long
+    if (previewInFlight)
+        frameGovernor.recordFrame(combination, previewStep, pixels, currFunction->getNumTerms(),
+                                  now - previewStarted, false);
+    
+    previewSettleTimer->start();
+    renderPreview(frameGovernor.interactiveStep(combination, pixels, currFunction->getNumTerms()));
+}
+
+void Interface::renderPreview(int finestStep)
+{
     imageDataSeries->clear();
     
     snapshotButton->setEnabled(false);
     
+    previewStep = finestStep;
+    previewStarted = previewClock.elapsed();
+    previewInFlight = true;
+    
     displayProgressBar->reset();
-    previewDisplayPort->paintToDisplay(disp);
+    previewDisplayPort->paintToDisplay(disp, finestStep);
     updateAspectRatio();
     
 }
 
+// times the frame that just reached the preview
+void Interface::recordPreviewFrame()
+{
+    if (!previewInFlight) {
+        return;
+    }
+    
+    previewInFlight = false;
+    FrameGovernor::Combination combination(functionSel->currentIndex(), colorwheelSel->currentIndex());
+    frameGovernor.recordFrame(combination, previewStep, disp->getWidth() * disp->getHeight(),
+                              currFunction->getNumTerms(), previewClock.elapsed() - previewStarted, true);
+}
+
+// the interaction has stopped; draws its last state at full quality
+void Interface::settlePreview()
+{
+    if (previewStep > 1) {
+        renderPreview(1);
+    }
+}
+
 // slot function called when clicked "update preview" button to add to history and update the preview display to reflect current settings
 void Interface::snapshotFunction()
 {
@@ -1798,6 +1905,19 @@ void Interface::aspectRatioLocked(bool checked){
         aspectRatioCheckLock = false;
 }
 
+// takes effect from the next render on, exports included
+void Interface::changeEvaluationMode(int index)
+{
+    settings->EvaluationMode = evaluationSel->itemData(index).toInt();
+    updatePreviewDisplay();
+}
+
+// takes effect as the preview's tiles next look up their basis planes
+void Interface::changeBasisCacheBudget(int megabytes)
+{
+    settings->BasisCacheBudget = megabytes;
+}
+
 void Interface::changingSliderWorldHeight(double val){
     settings->Height = val;
     worldHeightEdit->setText(QString::number(val));
@@ -2072,9 +2192,7 @@ void Interface::startImageExport()
     
     dispLayout->insertLayout(2, exportProgressBar->layout);
     
-    QImage *output = new QImage(settings->OWidth, settings->OHeight, QImage::Format_RGB32);
-
-    imageExportPort->exportImage(output, fileName);
+    imageExportPort->exportImage(fileName);
     
 }
 
@@ -35,6 +35,7 @@
 #include <QMessageBox>
 #include <QDialogButtonBox>
 #include <QTimer>
+#include <QElapsedTimer>
 #include <QRadioButton>
 #include <QColorDialog>
 #include <QObject>
@@ -52,6 +53,7 @@
 #include "historydisplay.h"
 #include "polarplane.h"
 #include "port.h"
+#include "framegovernor.h"
 #include "colorwheel.h"
 
 #define MAX_NUM_TERMS 99
@@ -499,6 +501,8 @@ public:
     QHBoxLayout *imageStretchXLayout;
     QHBoxLayout *imageStretchYLayout;
     QHBoxLayout *aspectRatioLayout;
+    QHBoxLayout *evaluationLayout;
+    QHBoxLayout *basisBudgetLayout;
     
     QLabel *XShiftLabel;
     QLabel *YShiftLabel;
@@ -510,6 +514,10 @@ public:
     QLabel *worldWidthLabel;
     QLabel *worldHeightLabel;
     QLabel *scalingAspectRatioLabel;
+    QLabel *evaluationLabel;
+    QComboBox *evaluationSel;
+    QLabel *basisBudgetLabel;
+    QSpinBox *basisBudgetSpinBox;
     QDoubleSlider *worldWidthEditSlider;
     QDoubleSlider *worldHeightEditSlider;
     CustomLineEdit *worldWidthEdit;
@@ -532,6 +540,12 @@ public:
     ProgressBar *displayProgressBar;
     ProgressBar *exportProgressBar;
     
+    // how many terms the preview left out as finer than a pixel
+    QLabel *skippedTermsLabel;
+    // shown while the preview's period grid (in the FFT and domain
+    // evaluation modes) is too far off and the exact path is used instead
+    QLabel *periodGridLabel;
+    
     // OUTPUT IMAGE DIM POP UP
     QWidget *imageDimensionsPopUp;
     QVBoxLayout *imageDimensionsPopUpLayout;
@@ -579,6 +593,8 @@ signals:
     //TODO for each change function, push current value onto the undostack...each action has its own command?
     void changeFunction(int index);
     void aspectRatioLocked(bool checked);
+    void changeEvaluationMode(int index);
+    void changeBasisCacheBudget(int megabytes);
     void changingSliderWorldHeight(double val);
     void changingSliderWorldWidth(double val);
     void changingBoxWorldHeight(double val);
@@ -625,11 +641,17 @@ signals:
     void popUpImageExportFinished(const QString &filePath);
     
     void resetMainWindowButton(const bool &status);
+    void recordPreviewFrame();
+    void settlePreview();
     
     void showFunctionIcons() { functionIconsWindow->hide(), functionIconsWindow->show(); }
     void showOverflowColorPopUp() { setOverflowColorPopUp->show(); }
     
     void addNewImageDataPoint(const ComplexValue &data) { *imageDataSeries << QPointF(data.real(), data.imag()); selectedPixelX.push_back(data.real()); selectedPixelY.push_back(data.imag());}
+    void updateSkippedTerms(int count) {
+        skippedTermsLabel->setText(tr("%n term(s) finer than a pixel left out of the preview", 0, count));
+        skippedTermsLabel->setVisible(count > 0);
+    }
     void showImageDataGraph() { updateImageDataGraph(); imageDataWindow->hide(); imageDataWindow->show(); }
     void updateImageDataGraph();
 
@@ -679,6 +701,7 @@ private:
     void removeTableTerm(int row);
     void refreshLabels();
     void updatePreviewDisplay();
+    void renderPreview(int finestStep);
     void errorHandler(const int &flag);
     void refreshTableTerms();
     void refreshMainWindowTerms();
@@ -711,6 +734,15 @@ private:
     bool widthChanged;
     bool errPrint;
     
+    //interactive preview timing (see updatePreviewDisplay)
+    FrameGovernor frameGovernor;
+    QElapsedTimer previewClock;
+    QTimer *previewSettleTimer;
+    qint64 lastPreviewRequest;      //ms on previewClock, -1 before the first one
+    qint64 previewStarted;
+    int previewStep;                //finest pass of the frame last asked for
+    bool previewInFlight;
+    
     //I/O-related variables    
     QString saveloadPath;
     QString currFileName;
@@ -16,7 +16,7 @@ public:
     IOThread(QObject *parent = 0);
     ~IOThread();
     
-    void prepareToWrite(QImage *output, const QString &filePathToExport);
+    void prepareToWrite(const QImage &output, const QString &filePathToExport);
     
 signals:
     void finishedExport(const QString &result);
@@ -27,7 +27,7 @@ protected:
 private:
     QMutex mutex;
     
-    QImage *output;
+    QImage output;
     QString filePathToExport;
     QString result;
 };
@@ -0,0 +1,340 @@
+#include "periodgrid.h"
+#include "batchkernels.h"
+#include "fft.h"
+
+#include <cmath>
+
+#include <QHash>
+#include <QList>
+#include <QMutex>
+#include <QMutexLocker>
+
+static const double TWO_PI = 6.28318530717958647692;
+
+static inline int wrap(int i, int n)
+{
+    i %= n;
+    return i < 0 ? i + n : i;
+}
+
+// Catmull-Rom weights for the four grid points around fraction t
+static inline void catmullRom(double t, double *w)
+{
+    double t2 = t * t, t3 = t2 * t;
+    w[0] = 0.5 * (-t3 + 2.0 * t2 - t);
+    w[1] = 0.5 * (3.0 * t3 - 5.0 * t2 + 2.0);
+    w[2] = 0.5 * (-3.0 * t3 + 4.0 * t2 + t);
+    w[3] = 0.5 * (t3 - t2);
+}
+
+void PeriodGrid::setLattice(const FunctionPlan &plan, int uSize, int vSize)
+{
+    Xx = plan.Xx; Xy = plan.Xy;
+    Yx = plan.Yx; Yy = plan.Yy;
+
+    this->uSize = uSize;
+    this->vSize = vSize;
+    samples.fill(std::complex<double>(0.0, 0.0), uSize * vSize);
+
+    magnitude = 0.0;
+    for (int k = 0; k < plan.waves.size(); k++)
+        magnitude += std::abs(plan.waves[k].coeff);
+}
+
+// measures the interpolation error at probe points spread over the period
+// by an additive (golden ratio) sequence in u and v
+void PeriodGrid::measureError(const FunctionPlan &plan)
+{
+    double determinant = Xx * Yy - Xy * Yx;
+    QVector<double> px(FFT_ERROR_PROBES), py(FFT_ERROR_PROBES);
+    QVector<double> re(FFT_ERROR_PROBES), im(FFT_ERROR_PROBES);
+    for (int k = 0; k < FFT_ERROR_PROBES; k++)
+    {
+        double u = std::fmod(0.5 + k * 0.6180339887498949, 1.0);
+        double v = std::fmod(0.5 + k * 0.7548776662466927, 1.0);
+        double X = TWO_PI * u, Y = TWO_PI * v;
+        px[k] = (Yy * X - Xy * Y) / determinant;
+        py[k] = (Xx * Y - Yx * X) / determinant;
+    }
+
+    evaluateLatticeBatch(plan, px.constData(), py.constData(), FFT_ERROR_PROBES, re.data(), im.data());
+
+    maxError = 0.0;
+    for (int k = 0; k < FFT_ERROR_PROBES; k++)
+        maxError = qMax(maxError, std::abs(sample(px[k], py[k]) - std::complex<double>(re[k], im[k])));
+}
+
+void PeriodGrid::build(const FunctionPlan &plan, int oversampling)
+{
+    clear();
+    if (!plan.lattice || plan.waves.isEmpty()) return;
+
+    setLattice(plan,
+               qMin(smoothLength(qMax(4, oversampling * (plan.nMax - plan.nMin + 1))), MAX_PERIOD_GRID_SIZE),
+               qMin(smoothLength(qMax(4, oversampling * (plan.mMax - plan.mMin + 1))), MAX_PERIOD_GRID_SIZE));
+
+    // the spectrum holds each wave's coefficient at its (wrapped) frequency;
+    // the inverse transform then evaluates the series at every grid point
+    for (int k = 0; k < plan.waves.size(); k++)
+    {
+        const PlanTerm &wave = plan.waves[k];
+        samples[wrap(wave.n, uSize) * vSize + wrap(wave.m, vSize)] += wave.coeff;
+    }
+
+    fft2D(samples, uSize, vSize, +1);
+
+    measureError(plan);
+}
+
+// the unsigned, positively weighted operations of a group's orbit; the
+// function is invariant under these when they form a group, which is
+// checked by closure (otherwise only the identity is used)
+static QVector<OrbitOp> closePointGroup(const WallpaperGroup *group)
+{
+    QVector<OrbitOp> ops;
+    OrbitOp identity = { 1, 0, 0, 1, 1.0, NO_SIGN };
+    ops.push_back(identity);
+    if (!group) return ops;
+
+    ops.clear();
+    for (int k = 0; k < group->count; k++)
+        if (group->ops[k].sign == NO_SIGN && group->ops[k].weight > 0.0)
+            ops.push_back(group->ops[k]);
+
+    for (int i = 0; i < ops.size(); i++)
+    {
+        for (int j = 0; j < ops.size(); j++)
+        {
+            const OrbitOp &g = ops[i], &h = ops[j];
+            int a = g.a * h.a + g.b * h.c, b = g.a * h.b + g.b * h.d;
+            int c = g.c * h.a + g.d * h.c, d = g.c * h.b + g.d * h.d;
+
+            bool closed = false;
+            for (int k = 0; k < ops.size() && !closed; k++)
+                closed = ops[k].a == a && ops[k].b == b && ops[k].c == c && ops[k].d == d;
+
+            if (!closed) {
+                ops.clear();
+                ops.push_back(identity);
+                return ops;
+            }
+        }
+    }
+
+    return ops;
+}
+
+// the groups are static tables, so each one's point group is only worked
+// out the first time it is asked for
+static QVector<OrbitOp> pointGroup(const WallpaperGroup *group)
+{
+    static QMutex cacheMutex;
+    static QHash<const WallpaperGroup *, QVector<OrbitOp> > cache;
+
+    QMutexLocker locker(&cacheMutex);
+
+    if (!cache.contains(group))
+        cache.insert(group, closePointGroup(group));
+
+    return cache.value(group);
+}
+
+void PeriodGrid::buildFromDomain(const FunctionPlan &plan, int oversampling)
+{
+    clear();
+    if (!plan.lattice || plan.waves.isEmpty()) return;
+
+    // the point group mixes u and v, so the grid has to be square
+    int span = qMax(plan.nMax - plan.nMin, plan.mMax - plan.mMin) + 1;
+    int size = qMin(smoothLength(qMax(4, oversampling * span)), MAX_PERIOD_GRID_SIZE);
+    setLattice(plan, size, size);
+
+    // map every grid point to the first point of its orbit, collecting the
+    // representatives' coordinates for one batch evaluation
+    QVector<OrbitOp> ops = pointGroup(plan.group);
+    QVector<int> representative(size * size, -1);
+    QVector<double> px, py;
+    double determinant = Xx * Yy - Xy * Yx;
+
+    for (int a = 0; a < size; a++)
+    {
+        for (int b = 0; b < size; b++)
+        {
+            if (representative[a * size + b] >= 0) continue;
+
+            int index = px.size();
+            for (int k = 0; k < ops.size(); k++)
+            {
+                // positions transform by the transpose of the frequency map
+                int ga = wrap(ops[k].a * a + ops[k].c * b, size);
+                int gb = wrap(ops[k].b * a + ops[k].d * b, size);
+                representative[ga * size + gb] = index;
+            }
+
+            double X = TWO_PI * a / size, Y = TWO_PI * b / size;
+            px.push_back((Yy * X - Xy * Y) / determinant);
+            py.push_back((Xx * Y - Yx * X) / determinant);
+        }
+    }
+
+    QVector<double> re(px.size()), im(px.size());
+    evaluateLatticeBatch(plan, px.constData(), py.constData(), px.size(), re.data(), im.data());
+
+    for (int k = 0; k < size * size; k++)
+        samples[k] = std::complex<double>(re[representative[k]], im[representative[k]]);
+
+    measureError(plan);
+}
+
+// whether two plans have the same grid: the same lattice and waves, and
+// for a domain grid the same point group
+static bool sameGrid(const FunctionPlan &a, const FunctionPlan &b, bool fromDomain)
+{
+    if (a.Xx != b.Xx || a.Xy != b.Xy || a.Yx != b.Yx || a.Yy != b.Yy)
+        return false;
+    if (fromDomain && a.group != b.group)
+        return false;
+    if (a.waves.size() != b.waves.size())
+        return false;
+
+    for (int k = 0; k < a.waves.size(); k++)
+    {
+        const PlanTerm &s = a.waves[k], &t = b.waves[k];
+        if (s.n != t.n || s.m != t.m || s.coeff != t.coeff)
+            return false;
+    }
+
+    return true;
+}
+
+struct SharedPeriodGrid
+{
+    FunctionPlan plan;
+    bool fromDomain;
+    QSharedPointer<const PeriodGrid> grid;  // null if over tolerance
+};
+
+QSharedPointer<const PeriodGrid> PeriodGrid::shared(const FunctionPlan &plan, bool fromDomain)
+{
+    static QMutex cacheMutex;
+    static QList<SharedPeriodGrid> cache;   // most recently used first
+
+    QMutexLocker locker(&cacheMutex);
+
+    for (int k = 0; k < cache.size(); k++)
+    {
+        if (cache[k].fromDomain == fromDomain && sameGrid(cache[k].plan, plan, fromDomain)) {
+            cache.move(k, 0);
+            return cache[0].grid;
+        }
+    }
+
+    QSharedPointer<PeriodGrid> grid(new PeriodGrid);
+    if (fromDomain)
+        grid->buildFromDomain(plan);
+    else
+        grid->build(plan);
+    if (!grid->isAccurate())
+        grid.clear();
+
+    SharedPeriodGrid entry;
+    entry.plan = plan;
+    entry.fromDomain = fromDomain;
+    entry.grid = grid;
+    cache.prepend(entry);
+    while (cache.size() > PERIOD_GRID_CACHE_SIZE)
+        cache.removeLast();
+
+    return entry.grid;
+}
+
+void PeriodGrid::clear()
+{
+    uSize = vSize = 0;
+    samples.clear();
+    maxError = magnitude = 0.0;
+}
+
+std::complex<double> PeriodGrid::sample(double x, double y) const
+{
+    double u = (Xx * x + Xy * y) / TWO_PI * uSize;
+    double v = (Yx * x + Yy * y) / TWO_PI * vSize;
+    double a0 = std::floor(u), b0 = std::floor(v);
+
+    double wu[4], wv[4];
+    catmullRom(u - a0, wu);
+    catmullRom(v - b0, wv);
+
+    int a = wrap(int(std::fmod(a0, uSize)) - 1, uSize);
+    int b = wrap(int(std::fmod(b0, vSize)) - 1, vSize);
+
+    std::complex<double> ans(0.0, 0.0);
+    for (int i = 0; i < 4; i++)
+    {
+        const std::complex<double> *row = samples.constData() + wrap(a + i, uSize) * vSize;
+        std::complex<double> partial(0.0, 0.0);
+        for (int j = 0; j < 4; j++)
+            partial += wv[j] * row[wrap(b + j, vSize)];
+        ans += wu[i] * partial;
+    }
+
+    return ans;
+}
+
+void PeriodGrid::sampleColumn(double x, const double *ys, int count, double *re, double *im) const
+{
+    for (int k = 0; k < count; k++)
+    {
+        std::complex<double> value = sample(x, ys[k]);
+        re[k] = value.real();
+        im[k] = value.imag();
+    }
+}
+
+void axisPeriods(const FunctionPlan &plan, double *xPeriod, double *yPeriod)
+{
+    *xPeriod = *yPeriod = 0.0;
+    if (!plan.lattice) return;
+
+    // world vectors that advance X or Y alone by 2pi
+    double determinant = plan.Xx * plan.Yy - plan.Xy * plan.Yx;
+    if (determinant == 0.0) return;
+    double ux = TWO_PI * plan.Yy / determinant, uy = -TWO_PI * plan.Yx / determinant;
+    double vx = -TWO_PI * plan.Xy / determinant, vy = TWO_PI * plan.Xx / determinant;
+
+    const int range = 6;
+    for (int i = -range; i <= range; i++)
+    {
+        for (int j = 0; j <= range; j++)
+        {
+            if (j == 0 && i <= 0) continue;
+            double px = i * ux + j * vx, py = i * uy + j * vy;
+            double length = std::sqrt(px * px + py * py);
+
+            if (std::fabs(py) <= 1e-9 * length && (*xPeriod == 0.0 || std::fabs(px) < *xPeriod))
+                *xPeriod = std::fabs(px);
+            if (std::fabs(px) <= 1e-9 * length && (*yPeriod == 0.0 || std::fabs(py) < *yPeriod))
+                *yPeriod = std::fabs(py);
+        }
+    }
+}
+
+int replicationStride(double period, double pixelStep, int pixels)
+{
+    pixelStep = std::fabs(pixelStep);
+    if (period <= 0.0 || pixelStep <= 0.0) return 0;
+
+    for (int multiple = 1; multiple <= MAX_PERIOD_MULTIPLE; multiple++)
+    {
+        double exact = multiple * period / pixelStep;
+        int stride = int(std::floor(exact + 0.5));
+        if (stride < 1) continue;
+        if (stride >= pixels) return 0;
+
+        double drift = std::fabs(stride - exact) * ((pixels - 1) / stride);
+        if (drift <= TILE_DRIFT_TOLERANCE)
+            return stride;
+    }
+
+    return 0;
+}
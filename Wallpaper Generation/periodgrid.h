@@ -0,0 +1,83 @@
+#ifndef PERIODGRID_H
+#define PERIODGRID_H
+
+#include <complex>
+
+#include <QSharedPointer>
+#include <QVector>
+
+#include "functions.h"
+
+const int DEFAULT_FFT_OVERSAMPLING = 8;     // grid points per wavelength of the span
+const int MAX_PERIOD_GRID_SIZE = 4096;      // per side
+const double FFT_ERROR_TOLERANCE = 1e-3;    // relative to the sum of |coeff|
+const int FFT_ERROR_PROBES = 1024;
+
+// how many plans PeriodGrid::shared() remembers the grid of (typically the
+// preview's and the history icons' or the export's)
+const int PERIOD_GRID_CACHE_SIZE = 3;
+
+// One lattice period of a lattice function, sampled on a uniform grid in
+// the lattice coordinates u = X/2pi and v = Y/2pi. In those coordinates the
+// function is an ordinary Fourier series with integer frequencies (n, m),
+// so the whole grid comes out of a single inverse 2D FFT of the plan's
+// waves. Points are read back with periodic Catmull-Rom interpolation, and
+// build() measures the worst interpolation error against direct evaluation
+// at FFT_ERROR_PROBES points spread over the period.
+//
+// buildFromDomain() fills the same grid by direct evaluation instead, but
+// only at one representative point per orbit of the group's point group
+// (its unsigned orbit operations, acting on (u, v) through the transposed
+// matrices); every other grid point takes its representative's value. For
+// p6m that evaluates about a twelfth of the grid, for p4m an eighth.
+//
+// shared() builds the grid of a plan once and keeps it for the renders
+// that follow, along with the outcome of its error measurement: a grid
+// over tolerance comes back as a null pointer, every time, without being
+// sampled or probed again.
+class PeriodGrid
+{
+public:
+    PeriodGrid() : uSize(0), vSize(0), maxError(0.0), magnitude(0.0) { }
+    
+    static QSharedPointer<const PeriodGrid> shared(const FunctionPlan &plan, bool fromDomain);
+
+    void build(const FunctionPlan &plan, int oversampling = DEFAULT_FFT_OVERSAMPLING);
+    void buildFromDomain(const FunctionPlan &plan, int oversampling = DEFAULT_FFT_OVERSAMPLING);
+    void clear();
+
+    std::complex<double> sample(double x, double y) const;
+    void sampleColumn(double x, const double *ys, int count, double *re, double *im) const;
+
+    bool isEmpty() const { return uSize == 0; }
+    double errorBound() const { return maxError; }
+    bool isAccurate() const { return !isEmpty() && maxError <= FFT_ERROR_TOLERANCE * magnitude; }
+
+private:
+    void setLattice(const FunctionPlan &plan, int uSize, int vSize);
+    void measureError(const FunctionPlan &plan);
+
+    int uSize, vSize;
+    double Xx, Xy, Yx, Yy;
+    QVector<std::complex<double> > samples;   // [a * vSize + b] is f at u = a/uSize, v = b/vSize
+    double maxError, magnitude;
+};
+
+// Lattice periods of a plan that lie along the world x and y axes (the
+// shortest among small integer combinations of the basis periods), or 0
+// where there is none.
+void axisPeriods(const FunctionPlan &plan, double *xPeriod, double *yPeriod);
+
+// A scanline of `pixels` samples spaced pixelStep apart repeats, up to a
+// shift, every `stride` samples when some multiple of the period is close
+// to a whole number of pixels. Copying instead of evaluating then places
+// the sample at pixel i*stride + j up to i*|stride - multiple*period/step|
+// pixels away from where it belongs. replicationStride() returns the
+// smallest stride that keeps that drift within TILE_DRIFT_TOLERANCE pixels
+// over the whole scanline, or 0 if there is none (in which case every
+// pixel has to be evaluated).
+const double TILE_DRIFT_TOLERANCE = 0.25;
+const int MAX_PERIOD_MULTIPLE = 16;
+int replicationStride(double period, double pixelStep, int pixels);
+
+#endif // PERIODGRID_H
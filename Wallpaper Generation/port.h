@@ -16,8 +16,8 @@ public:
     virtual ~Port(){;}
     
     // ACTIONS
-    void exportImage(QImage *output, const QString &fileName);
-    void paintToDisplay(Display *display);
+    void exportImage(const QString &fileName);
+    void paintToDisplay(Display *display, int finestStep = 1);
     void paintHistoryIcon(HistoryItem *item);
     
     // SETTERS
@@ -41,6 +41,8 @@ public:
         
         controller->changeDimensions(newWidth, newHeight);
     }
+    void setTileSize(const QSize &size) { controller->setTileSize(size); }
+    void setProgressive(bool status) { controller->setProgressive(status); }
     
     
     Controller *getControllerObject() { return controllerObject; }
@@ -50,7 +52,6 @@ public:
         if (!currColorWheel) delete currColorWheel;
         if (!currSettings) delete currSettings;
         if (!display) delete display;
-        if (!output) delete output;
         if (!controller) delete controller;
         if (!controllerObject) delete controllerObject;
     }
@@ -63,11 +64,11 @@ protected:
     int overallWidth, overallHeight;
     
 private:
-    void render(QImage *output, const int &actionFlag);
-    void render(Display *display, const int &actionFlag);
+    void render(const QSharedPointer<RenderTarget> &output, const int &actionFlag);
+    void render(Display *display, const int &actionFlag, int finestStep = 1);
     
     Display *display;
-    QImage *output;
+    QSharedPointer<RenderTarget> output;    // the export in progress
     QString filePathToExport;
     
     ControllerThread *controller;
@@ -80,6 +81,7 @@ signals:
     private slots:
     void handleRenderedImage(const int &actionFlag);
     void handleFinishedExport(const QString &filePath) { emit finishedExport(filePath); }
+    void handleFinishedTile(const QRect &rect) { display->update(rect); }
 
 };
 
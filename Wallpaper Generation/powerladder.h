@@ -0,0 +1,40 @@
+#ifndef POWERLADDER_H
+#define POWERLADDER_H
+
+#include <complex>
+
+#include <QVarLengthArray>
+
+// The integer powers z^lo .. z^hi (lo <= 0 <= hi) of one complex number,
+// built by repeated multiplication out from z^0 = 1 so that all the terms
+// evaluated at a pixel can share them instead of calling pow() each.
+// Negative powers are powers of 1/z, which is computed once.
+class PowerLadder
+{
+public:
+    PowerLadder(const std::complex<double> &z, int lo, int hi) : powers(hi - lo + 1)
+    {
+        zero = powers.data() - lo;
+        zero[0] = 1.0;
+        
+        for (int p = 1; p <= hi; p++)
+            zero[p] = zero[p - 1] * z;
+        
+        if (lo < 0) {
+            std::complex<double> inverse = 1.0 / z;
+            for (int p = -1; p >= lo; p--)
+                zero[p] = zero[p + 1] * inverse;
+        }
+    }
+    
+    const std::complex<double> &operator[](int p) const { return zero[p]; }
+    
+private:
+    PowerLadder(const PowerLadder &);
+    PowerLadder &operator=(const PowerLadder &);
+    
+    QVarLengthArray<std::complex<double>, 64> powers;
+    std::complex<double> *zero;
+};
+
+#endif // POWERLADDER_H
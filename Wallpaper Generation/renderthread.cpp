@@ -3,7 +3,14 @@
 RenderThread::RenderThread(AbstractFunction *function, ColorWheel *colorwheel, Settings *settings, QSize outputSize, QObject *parent) : QThread(parent)
 {
     restart = false;
-    abort = false;
+    abort.storeRelease(0);
+    scheduler = 0;
+    worker = 0;
+    frame = 0;
+    working = 0;
+    step = 1;
+    lastPass = true;
+    actionFlag = IMAGE_EXPORT_FLAG;
     
     currFunction = function;
     currColorWheel = colorwheel;
@@ -18,25 +25,26 @@ RenderThread::RenderThread(AbstractFunction *function, ColorWheel *colorwheel, S
 RenderThread::~RenderThread()
 {
     mutex.lock();
-    abort = true;
+    abort.storeRelease(1);
     condition.wakeOne();
     mutex.unlock();
     
     wait();
 }
 
-void RenderThread::render(QPoint topLeft, QPoint bottomRight, QWaitCondition *controllerCondition)
+void RenderThread::render(TileScheduler *scheduler, int frame, int worker, const QSharedPointer<RenderTarget> &target,
+                          const QSharedPointer<FrameEvaluation> &evaluation, int step, bool lastPass,
+                          QWaitCondition *controllerCondition)
 {
     QMutexLocker locker(&mutex);
     
-    this->topLeft = topLeft;
-    this->bottomRight = bottomRight;
-    topLeftXValue = topLeft.x();
-    topLeftYValue = topLeft.y();
-    
-    bottomRightXValue = bottomRight.x();
-    bottomRightYValue = bottomRight.y();
-    //qDebug()<<"bottomRightXValue:"<<bottomRightXValue<<"bottomRightYValue:"<<bottomRightYValue<<"\n";
+    this->scheduler = scheduler;
+    this->worker = worker;
+    this->target = target;
+    this->evaluation = evaluation;
+    this->step = step;
+    this->lastPass = lastPass;
+    this->frame = frame;
     this->controllerCondition = controllerCondition;
     worldYStart1 = currSettings->Height + currSettings->YCorner;
     worldYStart2 = currSettings->Height/overallHeight;
@@ -50,70 +58,285 @@ void RenderThread::render(QPoint topLeft, QPoint bottomRight, QWaitCondition *co
     }
 }
 
+void FrameField::prepare(const AbstractFunction *function, const FunctionPlan &plan, const QSharedPointer<CoordinateGrid> &coordinates,
+                         int columns, int rows, double rowStep, int mode, const QSharedPointer<const PeriodGrid> &grid)
+{
+    this->function = function;
+    this->plan = plan;
+    this->coordinates = coordinates;
+    this->rowStep = rowStep;
+    this->mode = mode;
+    this->grid = grid;
+    
+    // in FFT and domain modes one period is sampled up front and then
+    // resampled; without a grid (none was accurate enough) the exact
+    // tables are used instead.
+    // lattice functions factor into a per-column and a per-row phase,
+    // so the trig work is done once per frame rather than per pixel
+    bool periodMode = mode == FFT_EVALUATION || mode == DOMAIN_EVALUATION;
+    if ((mode == SEPARABLE_EVALUATION || periodMode) && plan.lattice && !grid) {
+        tables.build(plan, coordinates->worldX(), columns, coordinates->worldY(), rows);
+    }
+}
 
-void RenderThread::run()
+FieldEvaluator::FieldEvaluator(const FrameField &field, int firstColumn, int firstRow, int columns, int rows)
+    : field(&field), firstColumn(firstColumn), firstRow(firstRow), columns(columns), rows(rows)
 {
-    forever {
-        mutex.lock();
+}
+
+void FieldEvaluator::evaluateColumn(int column, double *re, double *im)
+{
+    const AbstractFunction *function = field->function;
+    const FunctionPlan &plan = field->plan;
+    double worldX = field->coordinates->worldX()[column + firstColumn];
+    const double *columnY = field->coordinates->worldY() + firstRow;
+    
+    //run the column through our mathematical function
+    switch (field->mode) {
+    case FFT_EVALUATION:
+    case DOMAIN_EVALUATION:
+        if (field->grid) {
+            field->grid->sampleColumn(worldX, columnY, rows, re, im);
+            break;
+        }
+        // fall through
+    case SEPARABLE_EVALUATION:
+        if (!field->tables.isEmpty()) {
+            field->tables.evaluateColumn(column + firstColumn, firstRow, rows, re, im);
+            break;
+        }
+        // no separable form (or nothing to render): fall through
+    case RECURRENCE_EVALUATION:
+        function->evaluateScanline(plan, worldX, columnY[0], 0.0, -field->rowStep, rows, re, im);
+        break;
+    case BATCH_EVALUATION:
+        // the column's points, gathered from the separable grid
+        pointX.fill(worldX, rows);
+        pointY.resize(rows);
+        std::copy(columnY, columnY + rows, pointY.begin());
+        function->evaluateBatch(plan, pointX.constData(), pointY.constData(), rows, re, im);
+        break;
+    default:
+        for (int y = 0; y < rows; y++) {
+            std::complex<double> fout = function->evaluate(plan, worldX, columnY[y]);
+            re[y] = fout.real();
+            im[y] = fout.imag();
+        }
+    }
+}
+
+bool FieldEvaluator::isPointwise() const
+{
+    int mode = field->mode;
+    bool pointwiseMode = mode == DIRECT_EVALUATION || mode == BATCH_EVALUATION || !field->plan.lattice;
+    return pointwiseMode && !field->grid && field->tables.isEmpty();
+}
+
+void FieldEvaluator::evaluateRows(int column, int firstRow, int rowStep, double *re, double *im)
+{
+    int count = (rows - firstRow + rowStep - 1) / rowStep;
+    if (count <= 0)
+        return;
+    
+    double worldX = field->coordinates->worldX()[column + firstColumn];
+    const double *columnY = field->coordinates->worldY() + this->firstRow;
+    
+    pointX.fill(worldX, count);
+    pointY.resize(count);
+    valuesRe.resize(count);
+    valuesIm.resize(count);
+    for (int i = 0; i < count; i++)
+        pointY[i] = columnY[firstRow + i * rowStep];
+    
+    field->function->evaluateBatch(field->plan, pointX.constData(), pointY.constData(), count, valuesRe.data(), valuesIm.data());
+    
+    for (int i = 0; i < count; i++) {
+        re[firstRow + i * rowStep] = valuesRe[i];
+        im[firstRow + i * rowStep] = valuesIm[i];
+    }
+}
+
+FrameEvaluation::FrameEvaluation(const AbstractFunction *function, const Settings &settings, int width, int height, bool draft)
+    : evaluated(function), skippedTerms(0), evaluationMode(settings.EvaluationMode), rowStep(settings.Height / height),
+      rejected(false)
+{
+    // previews and history icons leave out terms finer than a pixel
+    termList = function->compileTerms();
+    if (draft)
+        skippedTerms = function->limitDetail(termList, settings.Width / width, rowStep);
+    compiled = function->compile(termList);
+    
+    // whether a plan's period grid is accurate is settled once, when it is
+    // first rendered, and then kept with the grid
+    if ((evaluationMode == FFT_EVALUATION || evaluationMode == DOMAIN_EVALUATION) && compiled.lattice) {
+        periodGrid = PeriodGrid::shared(compiled, evaluationMode == DOMAIN_EVALUATION);
+        rejected = !periodGrid && !compiled.waves.isEmpty();
+    }
+    
+    // the world points of the whole render, shared with the other
+    // renders of the same world rectangle
+    grid = CoordinateGrid::shared(settings, width, height);
+    
+    evaluatedBlock = QSize(width, height);
+    if (compiled.lattice) {
+        // copies place pixels at most TILE_DRIFT_TOLERANCE off over the frame
+        double xPeriod, yPeriod;
+        axisPeriods(compiled, &xPeriod, &yPeriod);
+        int columnStride = replicationStride(xPeriod, settings.Width / width, width);
+        int rowStride = replicationStride(yPeriod, settings.Height / height, height);
+        evaluatedBlock = QSize(columnStride > 0 ? columnStride : width, rowStride > 0 ? rowStride : height);
+    }
+}
+
+const FrameField &FrameEvaluation::field()
+{
+    if (planBuilt.loadAcquire() == 0) {
+        QMutexLocker locker(&lock);
+        if (planBuilt.loadAcquire() == 0) {
+            planField.prepare(evaluated, compiled, grid, evaluatedBlock.width(), evaluatedBlock.height(), rowStep, evaluationMode,
+                              periodGrid);
+            planBuilt.storeRelease(1);
+        }
+    }
+    
+    return planField;
+}
+
+const FrameField &FrameEvaluation::termField(int k)
+{
+    if (termsBuilt.loadAcquire() == 0) {
+        QMutexLocker locker(&lock);
+        if (termsBuilt.loadAcquire() == 0) {
+            // a single term takes the phase tables even in the period
+            // modes; a period grid per term would cost more than it saves
+            termFields.resize(termList.terms.size());
+            for (unsigned int j = 0; j < (unsigned int) termFields.size(); j++)
+                termFields[j].prepare(evaluated, evaluated->compileTerm(j), grid, evaluatedBlock.width(), evaluatedBlock.height(),
+                                      rowStep, evaluationMode, QSharedPointer<const PeriodGrid>());
+            termsBuilt.storeRelease(1);
+        }
+    }
+    
+    return termFields[k];
+}
+
+QSharedPointer<FrameEvaluation> RenderThread::prepareFrame(int width, int height)
+{
+    mutex.lock();
+    const AbstractFunction *function = currFunction;
+    Settings settings = *currSettings;
+    bool draft = actionFlag != IMAGE_EXPORT_FLAG;
+    mutex.unlock();
+    
+    // outside the lock, as a new plan's period grid may take a while
+    return QSharedPointer<FrameEvaluation>(new FrameEvaluation(function, settings, width, height, draft));
+}
+
+// colors rows 0..rows-1 of the tile's column x from one column of the field
+template <typename Sample>
+void RenderThread::colorColumn(const Sample *re, const Sample *im, int x, int rows, const TileView &view)
+{
+    for (int y = 0; y < rows; y++)
+    {
+        //...then convert that complex output to a color according to our color wheel
         
-        double worldX, worldY;
-        double worldYStart1 = this->worldYStart1;
-        double worldYStart2 = this->worldYStart2;
-        double worldXStart = this->worldXStart;
-        double XCorner = currSettings->XCorner;
+        std::complex<double> fout(re[y], im[y]);
+        QRgb color = (*currColorWheel)(fout);
         
+        if (y % 10 == 0 && x % 10 == 0) {
+            emit newImageDataPoint(fout);
+        }
         
-        double outputWidth = bottomRightXValue - topLeftXValue;
-        double outputHeight = bottomRightYValue - topLeftYValue;
-
-        int translated = topLeftXValue;
+        // now, push the determined color to the corresponding point on the display
+        view.setPixel(x, y, color);
+    }
+}
 
-        std::complex<double> fout;
-        QPoint topLeft = this->topLeft;
-        QVector<QVector<QRgb>> colorMap(outputWidth, QVector<QRgb>(outputHeight));
+// draws one coarse pass of a preview tile: the pixel at every step-th
+// column and row of it, each filling the step x step block it is the
+// corner of. A pass after the first finds every other corner already
+// drawn by the one before, at twice its step, and keeps it. The samples
+// also go into kept, if given, for the later passes to build on
+void RenderThread::sketchTile(const FrameEvaluation &evaluation, const QRect &rect, int step, const TileView &view, FieldCache *kept)
+{
+    const QSharedPointer<CoordinateGrid> &grid = evaluation.coordinates();
+    bool refining = step < PREVIEW_COARSEST_STEP;
+    int samples = (rect.height() + step - 1) / step;
+    QVector<double> pointX(samples), pointY(samples);
+    QVector<double> fieldRe(samples), fieldIm(samples);
+    
+    for (int x = 0; x < rect.width(); x += step)
+    {
+        if (cancelled()) return;
         
-        mutex.unlock();
+        // the previous pass took every other row of every other column
+        int firstRow = 0, rowStep = step;
+        if (refining && x % (2 * step) == 0) {
+            firstRow = step;
+            rowStep = 2 * step;
+        }
         
+        int count = 0;
+        for (int y = firstRow; y < rect.height(); y += rowStep, count++) {
+            pointX[count] = grid->worldX()[rect.x() + x];
+            pointY[count] = grid->worldY()[rect.y() + y];
+        }
+        if (count == 0) continue;
         
+        evaluation.function()->evaluateBatch(evaluation.plan(), pointX.constData(), pointY.constData(), count, fieldRe.data(), fieldIm.data());
+        if (kept)
+            kept->storeSamples(x, firstRow, rowStep, count, fieldRe.constData(), fieldIm.constData());
         
-        for (int x = 0; x < outputWidth; x++)
+        int blockWidth = qMin(step, rect.width() - x);
+        for (int i = 0; i < count; i++)
         {
-            if (restart) { /* qDebug() << "renderThread aborts" ; */ break; }
-            if (abort) return;
+            int y = firstRow + i * rowStep;
+            int blockHeight = qMin(step, rect.height() - y);
+            QRgb color = (*currColorWheel)(std::complex<double>(fieldRe[i], fieldIm[i]));
             
-            for (int y = 0; y < outputHeight; y++)
-            {
-                if (restart) break;
-                if (abort) return;
-                
-                worldX = (x + translated) * worldXStart + XCorner;
-                worldY = worldYStart1 - y * worldYStart2;
-                
-                //run the point through our mathematical function
-                //...then convert that complex output to a color according to our color wheel
-                
-                fout = (*currFunction)(worldX,worldY);
-                QRgb color = (*currColorWheel)(fout);
-                
-                if (y % 10 == 0 && x % 10 == 0) {
-                    emit newImageDataPoint(fout);
-                }
-                
-                // now, push the determined color to the corresponding point on the display
-                colorMap[x][y] = color;
-            }
+            for (int v = 0; v < blockHeight; v++)
+                for (int u = 0; u < blockWidth; u++)
+                    view.setPixel(x + u, y + v, color);
+        }
+    }
+}
+
+void RenderThread::run()
+{
+    forever {
+        mutex.lock();
+        TileScheduler *scheduler = this->scheduler;
+        int worker = this->worker;
+        int frame = this->frame;
+        QSharedPointer<RenderTarget> target = this->target;
+        QSharedPointer<FrameEvaluation> evaluation = this->evaluation;
+        int step = this->step;
+        bool lastPass = this->lastPass;
+        mutex.unlock();
+        working = frame;
+        
+        // tiles are taken until the frame has none left; the first one also
+        // reports how many terms the frame leaves out
+        int tile;
+        QRect rect;
+        bool first = true;
+        while (scheduler->take(worker, frame, &tile, &rect))
+        {
+            renderTile(tile, rect, *evaluation, step, lastPass, first, target->view(rect));
+            if (abort.loadAcquire()) return;
             
-            if (x % 100 == 0) {
-                emit newProgress((x/outputWidth) * 100);
-            }
+            // a tile of a superseded frame is left unfinished and dropped;
+            // the Controller drops one superseded just after this check
+            if (!cancelled())
+                emit tileFinished(frame, rect);
+            first = false;
         }
+        if (abort.loadAcquire()) return;
 
         // qDebug() << currentThreadId() << "FINISHES RENDERING";
         
         mutex.lock();
         if (!restart) {
-            emit renderingFinished(topLeft, colorMap);
-
             condition.wait(&mutex);
         }
         // qDebug() << "thread" << QThread::currentThread() << "wakes up from restarting";
@@ -121,3 +344,132 @@ void RenderThread::run()
         mutex.unlock();        
     }   
 }
+
+// renders one tile of the frame into its view of the target; returns early
+// once its frame is superseded or on abort, leaving the tile unfinished
+void RenderThread::renderTile(int tile, const QRect &rect, FrameEvaluation &evaluation, int step, bool lastPass, bool reportSkipped,
+                              const TileView &view)
+{
+    // the preview keeps the field of its last render over each tile, so a
+    // color-only change just re-colors it, and while
+    // only coefficients change it re-sums cached basis planes instead of
+    // evaluating. The caches belong to the tile, whichever thread takes it
+    mutex.lock();
+    bool caching = actionFlag == DISPLAY_REPAINT_FLAG;
+    mutex.unlock();
+    
+    TileCaches *caches = caching ? scheduler->caches(tile) : 0;
+    QMutexLocker cacheLocker(caching ? &caches->lock : 0);
+    
+    mutex.lock();
+    
+    int outputWidth = rect.width();
+    int outputHeight = rect.height();
+    
+    int translated = rect.x();
+    int firstRow = rect.y();
+    
+    // the plan, the coordinate grid and the tables are the frame's, built
+    // once and shared read-only by every tile
+    if (reportSkipped) {
+        emit termsSkipped(evaluation.skipped());
+        emit periodGridRejected(evaluation.gridRejected());
+    }
+    
+    const FunctionPlan &terms = evaluation.terms();
+    QSharedPointer<CoordinateGrid> coordinates = evaluation.coordinates();
+    
+    // one column of function values at a time
+    QVector<double> fieldRe(outputHeight), fieldIm(outputHeight);
+    
+    JobKey job(evaluation.function(), terms, coordinates, translated, firstRow, outputWidth, outputHeight, evaluation.mode());
+    bool retained = caching && caches->field.holds(job, terms);
+    
+    // a coarse pass leaves out the tiles whose field is kept or can be
+    // re-summed, which are drawn about as fast at full resolution by the
+    // last pass, even when that is a coarse one itself
+    bool sketch = !caching || (!retained && !caches->basis.holds(job));
+    if (step > 1 && (sketch || !lastPass)) {
+        // the preview's field collects the samples pass by pass, from the
+        // first one on, for the full-resolution pass to reuse
+        FieldCache *samples = 0;
+        if (caching && sketch) {
+            if (step == PREVIEW_COARSEST_STEP)
+                caches->field.reset(job, terms);
+            if (step == PREVIEW_COARSEST_STEP || caches->field.holdsSketch(job, terms, 2 * step))
+                samples = &caches->field;
+        }
+        
+        mutex.unlock();
+        if (sketch)
+            sketchTile(evaluation, rect, step, view, samples);
+        if (samples && !cancelled())
+            samples->sketched(step);
+        return;
+    }
+    
+    // when the coarse passes went down to a step of 2, they already took
+    // the even rows of the even columns
+    BasisCache::Lookup lookup = BasisCache::BASIS_MISS;
+    bool corners = false;
+    if (caching && !retained) {
+        lookup = caches->basis.lookup(job, qint64(currSettings->BasisCacheBudget) << 20);
+        corners = lookup == BasisCache::BASIS_MISS && caches->field.holdsSketch(job, terms, 2);
+        if (!corners)
+            caches->field.reset(job, terms);
+    }
+    
+    mutex.unlock();
+    
+    int planes = lookup == BasisCache::BASIS_BUILD ? terms.terms.size() : 0;
+    for (int k = 0; k < planes && !cancelled(); k++)
+    {
+        FieldEvaluator termEvaluator(evaluation.termField(k), translated, firstRow, outputWidth, outputHeight);
+        for (int x = 0; x < outputWidth; x++)
+        {
+            if (cancelled()) return;
+            termEvaluator.evaluateColumn(x, caches->basis.planeRe(k, x), caches->basis.planeIm(k, x));
+        }
+    }
+    if (lookup == BasisCache::BASIS_BUILD && !cancelled())
+        caches->basis.finishBuilding();
+    
+    bool cached = lookup != BasisCache::BASIS_MISS && caches->basis.isBuilt();
+    if (cached)
+        caches->basis.combine(terms);
+    
+    // the frame's field is left unbuilt while its tiles have no need of it
+    FrameField idle;
+    bool evaluating = !retained && !cached;
+    FieldEvaluator evaluator(evaluating ? evaluation.field() : idle, translated, firstRow, outputWidth, outputHeight);
+    corners = corners && evaluating && evaluator.isPointwise();
+    
+    for (int x = 0; x < outputWidth; x++)
+    {
+        if (cancelled()) return;
+        
+        if (retained) {
+            colorColumn(caches->field.fieldRe(x), caches->field.fieldIm(x), x, outputHeight, view);
+        } else if (cached) {
+            caches->field.store(x, caches->basis.fieldRe(x), caches->basis.fieldIm(x));
+            colorColumn(caches->basis.fieldRe(x), caches->basis.fieldIm(x), x, outputHeight, view);
+        } else {
+            if (corners && x % 2 == 0) {
+                evaluator.evaluateRows(x, 1, 2, fieldRe.data(), fieldIm.data());
+                const FieldSample *keptRe = caches->field.fieldRe(x), *keptIm = caches->field.fieldIm(x);
+                for (int y = 0; y < outputHeight; y += 2) {
+                    fieldRe[y] = keptRe[y];
+                    fieldIm[y] = keptIm[y];
+                }
+            } else {
+                evaluator.evaluateColumn(x, fieldRe.data(), fieldIm.data());
+            }
+            
+            if (caching)
+                caches->field.store(x, fieldRe.constData(), fieldIm.constData());
+            colorColumn(fieldRe.constData(), fieldIm.constData(), x, outputHeight, view);
+        }
+    }
+    if (caching && !retained && !cancelled())
+        caches->field.finish();
+}
@@ -1,6 +1,7 @@
 #ifndef RENDERTHREAD_H
 #define RENDERTHREAD_H
 
+#include <QAtomicInt>
 #include <QThread>
 #include <QWaitCondition>
 #include <QMetaType>
@@ -8,6 +9,11 @@
 #include <QMutex>
 
 #include "functions.h"
+#include "batchkernels.h"
+#include "periodgrid.h"
+#include "coordinategrid.h"
+#include "tilescheduler.h"
+#include "rendertarget.h"
 #include "colorwheel.h"
 
 #include "geomath.h"
@@ -17,9 +23,124 @@ const int DISPLAY_REPAINT_FLAG = 1;
 const int HISTORY_ICON_REPAINT_FLAG = 2;
 const int IMAGE_EXPORT_FLAG = 3;
 
-typedef QVector<QVector<QRgb> > Q2DArray;
+// default size of the blocks a render is cut into for the render threads
+// (see TileScheduler), 0 meaning the whole image (or the evaluated block,
+// see FrameEvaluation::block) along that axis. Tiles are two cache
+// lines of a RenderTarget row wide, so that neighbouring tiles never write
+// the same line
+const int RENDER_TILE_WIDTH = 32;
+const int RENDER_TILE_HEIGHT = 0;
+
+// a preview is first drawn from one pixel in this many along each axis,
+// and then refined pass by pass, halving the step down to every pixel
+// (see ControllerThread::run and RenderThread::sketchTile)
+const int PREVIEW_COARSEST_STEP = 8;
+
 typedef std::complex<double> ComplexValue;
 
+// what evaluating one compiled plan takes over a whole frame (the laid-out
+// block of the shared coordinate grid), the way the evaluation mode (see
+// Settings::EvaluationMode) asks for: the given period grid, or else the
+// phase tables. prepare() builds it once per frame; after that it is
+// read-only and every tile evaluates from it through a FieldEvaluator of
+// its own
+class FrameField
+{
+public:
+    FrameField() : function(0), rowStep(0.0), mode(DEFAULT_EVALUATION_MODE) { }
+    
+    void prepare(const AbstractFunction *function, const FunctionPlan &plan, const QSharedPointer<CoordinateGrid> &coordinates,
+                 int columns, int rows, double rowStep, int mode, const QSharedPointer<const PeriodGrid> &grid);
+    
+private:
+    friend class FieldEvaluator;
+    
+    const AbstractFunction *function;
+    FunctionPlan plan;
+    QSharedPointer<CoordinateGrid> coordinates;
+    double rowStep;
+    int mode;
+    
+    QSharedPointer<const PeriodGrid> grid;
+    PhaseTables tables;
+};
+
+// evaluates a FrameField over one render job (a tile of the frame), a
+// column at a time. It only keeps the scratch buffers of one column, so
+// that any number of tiles can share the frame's field
+class FieldEvaluator
+{
+public:
+    FieldEvaluator(const FrameField &field, int firstColumn, int firstRow, int columns, int rows);
+    
+    void evaluateColumn(int column, double *re, double *im);
+    
+    // whether evaluateColumn() does the same work for every point, so that
+    // leaving points out saves their share of it (the tables, period grids
+    // and recurrence do theirs per column instead)
+    bool isPointwise() const;
+    // rows firstRow, firstRow + rowStep, ... of a column only, each written
+    // at its row
+    void evaluateRows(int column, int firstRow, int rowStep, double *re, double *im);
+    
+private:
+    const FrameField *field;
+    int firstColumn, firstRow, columns, rows;
+    
+    QVector<double> pointX, pointY;     // the points of one column, or of some of its rows
+    QVector<double> valuesRe, valuesIm; // the values at those rows
+};
+
+// What every tile of a render shares, made once per render by
+// RenderThread::prepareFrame(): the function's terms (less those finer than
+// a pixel, for drafts), the plan compiled from them, the evaluated block,
+// the plan's period grid (see PeriodGrid::shared) and the frame's fields.
+// The fields are built by the first tile that evaluates rather than up
+// front, since a preview whose tiles all keep their field or basis planes
+// needs none of them.
+class FrameEvaluation
+{
+public:
+    FrameEvaluation(const AbstractFunction *function, const Settings &settings, int width, int height, bool draft);
+    
+    const AbstractFunction *function() const { return evaluated; }
+    const FunctionPlan &terms() const { return termList; }
+    const FunctionPlan &plan() const { return compiled; }
+    int skipped() const { return skippedTerms; }
+    int mode() const { return evaluationMode; }
+    // whether the mode asked for a period grid that misses the plan by more
+    // than FFT_ERROR_TOLERANCE, so that the frame is evaluated exactly
+    bool gridRejected() const { return rejected; }
+    QSharedPointer<CoordinateGrid> coordinates() const { return grid; }
+    
+    // the part of the frame that has to be evaluated. Along an axis where
+    // the lattice repeats every replicationStride() pixels over the whole
+    // frame, that is one stride, and the rest of the frame is copied from
+    // it (see ControllerThread::run); elsewhere it is the whole frame
+    QSize block() const { return evaluatedBlock; }
+    
+    // of the plan, and of term k alone (for the basis planes, see
+    // BasisCache); the terms' fields are built all at once
+    const FrameField &field();
+    const FrameField &termField(int k);
+    
+private:
+    const AbstractFunction *evaluated;
+    FunctionPlan termList, compiled;
+    int skippedTerms;
+    int evaluationMode;
+    double rowStep;
+    QSharedPointer<CoordinateGrid> grid;
+    QSize evaluatedBlock;
+    QSharedPointer<const PeriodGrid> periodGrid;
+    bool rejected;
+    
+    QMutex lock;
+    QAtomicInt planBuilt, termsBuilt;
+    FrameField planField;
+    QVector<FrameField> termFields;
+};
+
 class RenderThread : public QThread
 {
     Q_OBJECT
@@ -30,7 +151,16 @@ public:
     explicit RenderThread(AbstractFunction *function, ColorWheel *colorwheel, Settings *settings, QSize outputSize, QObject *parent = 0);
     ~RenderThread();
     
-    void render(QPoint topLeft, QPoint bottomRight, QWaitCondition *controllerCondition);
+    // works through the scheduler's given frame as the given worker,
+    // writing the tiles into target. A step over 1 makes the frame one of
+    // the coarse passes of a preview, lastPass the one it ends with
+    void render(TileScheduler *scheduler, int frame, int worker, const QSharedPointer<RenderTarget> &target,
+                const QSharedPointer<FrameEvaluation> &evaluation, int step, bool lastPass,
+                QWaitCondition *controllerCondition);
+    
+    // what the tiles of a width x height render of the thread's function
+    // and settings share; one thread makes it for all of them
+    QSharedPointer<FrameEvaluation> prepareFrame(int width, int height);
     
     // SETTERS
     void changeFunction(AbstractFunction *newFunction) { currFunction = newFunction; }
@@ -47,14 +177,30 @@ public:
         overallWidth = newWidth;
         overallHeight = newHeight;
     }
+    void setActionFlag(int flag) {
+        QMutexLocker locker(&mutex);
+        actionFlag = flag;
+    }
     
 protected:
     void run() Q_DECL_OVERRIDE;
     
+private:
+    // whether the frame being worked on has been superseded (or the thread
+    // is shutting down); polled between columns
+    bool cancelled() const { return abort.loadAcquire() || !scheduler->isCurrent(working); }
+    
+    void renderTile(int tile, const QRect &rect, FrameEvaluation &evaluation, int step, bool lastPass, bool reportSkipped,
+                    const TileView &view);
+    void sketchTile(const FrameEvaluation &evaluation, const QRect &rect, int step, const TileView &view, FieldCache *kept);
+    template <typename Sample>
+    void colorColumn(const Sample *re, const Sample *im, int x, int rows, const TileView &view);
+    
 signals:
-    void renderingFinished(const QPoint &startPoint, const Q2DArray &result);
-    void newProgress(const double &progress);
+    void tileFinished(int frame, const QRect &rect);
     void newImageDataPoint(const ComplexValue &data);
+    void termsSkipped(int count);
+    void periodGridRejected(bool rejected);
     
 private:
 
@@ -64,12 +210,26 @@ private:
     QWaitCondition *controllerCondition;
     
     int overallWidth, overallHeight;
-    int topLeftXValue, topLeftYValue, bottomRightXValue, bottomRightYValue;
-    QPoint topLeft, bottomRight;
     double worldYStart1, worldYStart2, worldXStart;
     
     bool restart;
-    bool abort;
+    // set by the destructor while run() and cancelled() poll it
+    QAtomicInt abort;
+    
+    // where the tiles of the current frame come from, what they share and
+    // where they go
+    TileScheduler *scheduler;
+    int worker, frame;
+    QSharedPointer<RenderTarget> target;
+    QSharedPointer<FrameEvaluation> evaluation;
+    int working;            // the frame run() is on; used by the render thread alone
+    int step;               // pixels per sample along each axis
+    bool lastPass;
+    
+    // what the render is for: the preview keeps per-term basis planes and
+    // the finished field of each tile (see TileCaches), and draft renders
+    // (anything but an export) leave out terms finer than a pixel
+    int actionFlag;
     
     AbstractFunction *currFunction;
     ColorWheel *currColorWheel;
@@ -22,6 +22,21 @@ const int DEFAULT_OUTPUT_HEIGHT = 4800;
 const double PREVIEW_SCALING = 0.4;
 const int PARAMETER_SEPARATOR_LENGTH = 10;
 
+// how the render threads evaluate the function down each column (see
+// Settings::EvaluationMode and FieldEvaluator)
+const int DIRECT_EVALUATION = 0;        // one evaluate() per pixel
+const int BATCH_EVALUATION = 1;         // vectorized sum over the column
+const int RECURRENCE_EVALUATION = 2;    // phase rotation down the column
+const int SEPARABLE_EVALUATION = 3;     // per-column times per-row phase tables
+const int FFT_EVALUATION = 4;           // one FFT-synthesized lattice period, resampled
+const int DOMAIN_EVALUATION = 5;        // lattice period filled from its fundamental domain, resampled
+const int DEFAULT_EVALUATION_MODE = SEPARABLE_EVALUATION;
+
+// megabytes of basis planes the tiles of one preview may hold between them
+// (see Settings::BasisCacheBudget and BasisCache); 0 turns the planes off
+const int DEFAULT_BASIS_CACHE_BUDGET = 256;
+const int MAX_BASIS_CACHE_BUDGET = 4096;
+
 //struct that holds information about image and output properties
 struct Settings
 {
@@ -31,6 +46,8 @@ struct Settings
     double YCorner = DEFAULT_YCORNER;
     int OWidth = DEFAULT_OUTPUT_WIDTH;
     int OHeight = DEFAULT_OUTPUT_HEIGHT;
+    int EvaluationMode = DEFAULT_EVALUATION_MODE;
+    int BasisCacheBudget = DEFAULT_BASIS_CACHE_BUDGET;
     
     Settings* clone() {
         
@@ -41,6 +58,8 @@ struct Settings
         newSettings->YCorner = this->YCorner;
         newSettings->OWidth = this->OWidth;
         newSettings->OHeight = this->OHeight;
+        newSettings->EvaluationMode = this->EvaluationMode;
+        newSettings->BasisCacheBudget = this->BasisCacheBudget;
         
         return newSettings;
     }
@@ -55,7 +74,7 @@ public:
     
     HistoryItem(QObject *parent = 0) : QObject(parent) { }
     
-    QImage *getImage() { return preview->getImage(); }
+    const QImage &getImage() const { return preview->getImage(); }
     Display *getDisplay() { return preview; }
     
     QVBoxLayout *layoutWithLabelItem;
@@ -25,7 +25,16 @@ SOURCES += \
     controllerthread.cpp \
     historydisplay.cpp \
     iothread.cpp \
-    polarplane.cpp
+    polarplane.cpp \
+    batchkernels.cpp \
+    fft.cpp \
+    periodgrid.cpp \
+    coordinategrid.cpp \
+    basiscache.cpp \
+    fieldcache.cpp \
+    tilescheduler.cpp \
+    rendertarget.cpp \
+    framegovernor.cpp
 
 HEADERS  += \
     interface.h \
@@ -41,7 +50,17 @@ HEADERS  += \
     shared.h \
     historydisplay.h \
     iothread.h \
-    polarplane.h
+    polarplane.h \
+    batchkernels.h \
+    fft.h \
+    periodgrid.h \
+    powerladder.h \
+    coordinategrid.h \
+    basiscache.h \
+    fieldcache.h \
+    tilescheduler.h \
+    rendertarget.h \
+    framegovernor.h
 
 RESOURCES += \
     softwareresources.qrc